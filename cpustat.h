@@ -0,0 +1,30 @@
+// Per-CPU utilization counters and system load averages, as
+// returned by cpustats().  Visible to both user and kernel space;
+// user code must include param.h first for NCPU.
+
+// Load averages are fixed point with FSHIFT fraction bits, and
+// are resampled every LOADFREQ seconds.  EXP_n is
+// FIXED_1/exp(LOADFREQ/(n*60)), the decay per sample for an n
+// minute average.
+#define FSHIFT    11
+#define FIXED_1   (1 << FSHIFT)
+#define LOADFREQ  5
+#define EXP_1     1884
+#define EXP_5     2014
+#define EXP_15    2037
+
+struct cpustat {
+  uint64 idle;      // TSC cycles halted with nothing to run
+  uint nswitch;     // context switches onto this CPU
+  uint nintr;       // device and timer interrupts taken
+  uint nready;      // RUNNABLE processes allowed on this CPU
+  int pid;          // process running now, 0 if none
+};
+
+struct sysload {
+  uint64 tsc;       // TSC when the counters were read
+  uint load[3];     // 1, 5 and 15 minute load averages
+  uint nrun;        // RUNNABLE and RUNNING processes
+  int ncpu;
+  struct cpustat cpu[NCPU];
+};
@@ -4,12 +4,16 @@ struct file;
 struct inode;
 struct pipe;
 struct proc;
+struct procquery;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct sysload;
+struct trapframe;
 struct uproc;
+struct vmstat;
 
 // bio.c
 void            binit(void);
@@ -26,6 +30,10 @@ void            panic(char*) __attribute__((noreturn));
 void            do_shutdown(void);
 #endif // PDX_XV6
 
+// evtrace.c
+void            evtrace(int, int, int);
+void            evtraceinit(void);
+
 // exec.c
 int             exec(char*, char**);
 
@@ -62,6 +70,7 @@ int             writei(struct inode*, char*, uint, uint);
 void            ideinit(void);
 void            ideintr(void);
 void            iderw(struct buf*);
+void            iderwv(struct buf**, int);
 
 // ioapic.c
 void            ioapicenable(int irq, int cpu);
@@ -70,9 +79,16 @@ void            ioapicinit(void);
 
 // kalloc.c
 char*           kalloc(void);
+char*           kallocpages(int);
+char*           kzalloc(void);
+int             kzerofill(void);
 void            kfree(char*);
+void            kfreepages(char*, int);
 void            kinit1(void*, void*);
 void            kinit2(void*, void*);
+#ifdef KALLOC_TEST
+void            kalloctest(void);
+#endif // KALLOC_TEST
 
 // kbd.c
 void            kbdintr(void);
@@ -84,6 +100,7 @@ extern volatile uint*    lapic;
 void            lapiceoi(void);
 void            lapicinit(void);
 void            lapicstartap(uchar, uint);
+uint            tscus(uint64);
 void            microdelay(int);
 
 // log.c
@@ -92,6 +109,15 @@ void            log_write(struct buf*);
 void            begin_op();
 void            end_op();
 
+// mmap.c
+int             mmap(struct file*, int, int, int);
+void            mmapclose(struct proc*);
+int             mmapdup(struct proc*, struct proc*);
+int             mmapfault(struct proc*, uint, uint);
+int             mmapfill(struct proc*, uint, uint, int);
+uint            mmapnext(struct proc*, uint);
+int             munmap(uint, int);
+
 // mp.c
 extern int      ismp;
 void            mpinit(void);
@@ -108,10 +134,13 @@ int             pipewrite(struct pipe*, char*, int);
 
 //PAGEBREAK: 16
 // proc.c
+void            calcload(void);
 int             cpuid(void);
+int             evict(char*, uint);
 void            exit(void);
 int             fork(void);
 #ifdef CS333_P2
+void            cpulimit(void);
 uint            get_gid(void);
 uint            get_uid(void);
 uint            get_ppid(void);
@@ -120,8 +149,12 @@ int             get_procs(int, struct uproc *);
 #ifdef CS333_P4
 int             get_priority(int);
 #endif
+int             getaffinity(int);
+void            getcpustats(struct sysload*);
+int             getvmstat(int, struct vmstat*);
 int             growproc(int);
 int             kill(int);
+int             maxproc(int);
 struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            pinit(void);
@@ -131,7 +164,15 @@ void            proc_ready(void);
 void            proc_sleep(void);
 void            proc_zombie(void);
 #endif
+#ifdef CS333_P4
+void            priolend(struct sleeplock*);
+void            prioreturn(void);
+#endif
 void            procdump(void);
+#ifdef CS333_P2
+int             procquery(struct procquery*, struct uproc*, int);
+#endif  //CS333_P2
+void            procseq(struct proc*);
 void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 #ifdef CS333_P2
@@ -140,7 +181,11 @@ int             set_gid(uint);
 #endif  //CS333_P2
 #ifdef CS333_P4
 int             set_priority(int, int);
+int             set_priority_group(uint, int);
+int             set_priority_list(int*, int, int);
+int             set_tickets(int, int);
 #endif
+int             setaffinity(int, uint);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
@@ -149,6 +194,17 @@ void            wakeup(void*);
 void            yield(void);
 
 
+// profile.c
+void            kprofinit(void);
+void            kprofsample(struct trapframe*);
+
+// swap.c
+char*           pagealloc(pde_t*, int);
+void            swapfree(uint);
+int             swapin(pde_t*, uint);
+void            swapinit(int);
+int             swapinrange(pde_t*, uint, uint);
+
 // swtch.S
 void            swtch(struct context**, struct context*);
 
@@ -179,8 +235,11 @@ char*           strncpy(char*, const char*, int);
 // syscall.c
 int             argint(int, int*);
 int             argptr(int, char**, int);
+int             argrdptr(int, char**, int);
 int             argstr(int, char**);
 int             fetchint(uint, int*);
+int             fetchptr(uint, char**, int);
+int             fetchrdptr(uint, char**, int);
 int             fetchstr(uint, char**);
 void            syscall(void);
 
@@ -188,15 +247,27 @@ void            syscall(void);
 void            timerinit(void);
 
 // trap.c
+void            dblfault(void) __attribute__((noreturn));
 void            idtinit(void);
+void            istackinit(void);
 extern uint     ticks;
 void            tvinit(void);
 
+// trapasm.S
+int             callonstack(int (*)(struct trapframe*), struct trapframe*, char*);
+
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
 
+// vdso.c
+void            vdsodate(struct rtcdate*);
+void            vdsoinit(void);
+int             vdsomap(pde_t*, struct proc*);
+void            vdsosetproc(struct proc*);
+void            vdsotick(void);
+
 // vm.c
 void            seginit(void);
 void            kvmalloc(void);
@@ -208,10 +279,21 @@ void            freevm(pde_t*);
 void            inituvm(pde_t*, char*, uint);
 int             loaduvm(pde_t*, char*, struct inode*, uint, uint);
 pde_t*          copyuvm(pde_t*, uint);
+int             copyuvmrange(pde_t*, pde_t*, uint, uint);
+int             mappages(pde_t*, void*, uint, uint, int);
 void            switchuvm(struct proc*);
 void            switchkvm(void);
 int             copyout(pde_t*, uint, void*, uint);
 void            clearpteu(pde_t *pgdir, char *uva);
+uint*           walkpgdir(pde_t*, const void*, int);
+char*           kstackalloc(void);
+void            kstackfree(char*);
+void            memacct(pde_t*, int, int);
+uint            memuse(struct proc*, uint, uint);
+void            stackfill(struct proc*, uint, uint);
+int             stackfault(struct proc*, uint);
+void            vmcount(pde_t*, int);
+void            vmusage(pde_t*, uint*, uint*);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
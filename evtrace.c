@@ -0,0 +1,118 @@
+//
+// Scheduler event trace.
+//
+// While tracing is on, proc.c reports scheduling events through
+// evtrace(), which stamps them with the TSC and appends them to a
+// ring owned by the current CPU.  As in profile.c, only that CPU
+// adds to its ring, always with interrupts off, and readers hold
+// evtracelock, so recording an event takes no lock.  A full ring
+// drops new events and counts them.
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "schedtrace.h"
+
+#define NSCHEDEV 1024  // events buffered per CPU
+
+static struct {
+  struct schedevent buf[NSCHEDEV];
+  volatile uint head;  // next slot to fill
+  volatile uint tail;  // next event to read
+  uint drops;
+} rings[NCPU];
+
+static struct spinlock evtracelock;
+static volatile int evtraceon;
+
+void
+evtraceinit(void)
+{
+  initlock(&evtracelock, "evtrace");
+}
+
+// Record an event.  Interrupts must be off.
+void
+evtrace(int type, int pid, int arg)
+{
+  struct schedevent *e;
+  int c;
+
+  if(!evtraceon)
+    return;
+  c = cpuid();
+  if(rings[c].head - rings[c].tail == NSCHEDEV){
+    rings[c].drops++;
+    return;
+  }
+  e = &rings[c].buf[rings[c].head % NSCHEDEV];
+  e->tsc = rdtsc();
+  e->type = type;
+  e->cpu = c;
+  e->pid = pid;
+  e->arg = arg;
+
+  // Publish the event only once it is complete.
+  __sync_synchronize();
+  rings[c].head++;
+}
+
+// Control the trace and read its events.
+// schedtrace(STRACE_READ, buf, n) moves up to n events into buf,
+// each CPU's in order, and returns how many it moved.  The other
+// commands return 0, or the drop count for STRACE_DROPS.
+int
+sys_schedtrace(void)
+{
+  int cmd, n, c, got;
+  uint head, tail, drops;
+  struct schedevent *buf;
+
+  if(argint(0, &cmd) < 0)
+    return -1;
+  switch(cmd){
+  case STRACE_OFF:
+    evtraceon = 0;
+    return 0;
+  case STRACE_ON:
+    acquire(&evtracelock);
+    for(c = 0; c < ncpu; c++)
+      rings[c].drops = 0;
+    evtraceon = 1;
+    release(&evtracelock);
+    return 0;
+  case STRACE_DROPS:
+    drops = 0;
+    for(c = 0; c < ncpu; c++)
+      drops += rings[c].drops;
+    return drops;
+  case STRACE_READ:
+    if(argint(2, &n) < 0 || n < 0)
+      return -1;
+    // No more than the rings can hold, so n*sizeof(*buf) cannot wrap.
+    if(n > ncpu*NSCHEDEV)
+      n = ncpu*NSCHEDEV;
+    if(argptr(1, (void*)&buf, n*sizeof(*buf)) < 0)
+      return -1;
+    got = 0;
+    acquire(&evtracelock);
+    for(c = 0; c < ncpu && got < n; c++){
+      head = rings[c].head;
+      __sync_synchronize();
+      for(tail = rings[c].tail; tail != head && got < n; tail++)
+        buf[got++] = rings[c].buf[tail % NSCHEDEV];
+      // Hand the slots back only after they have been copied.
+      __sync_synchronize();
+      rings[c].tail = tail;
+    }
+    release(&evtracelock);
+    return got;
+  }
+  return -1;
+}
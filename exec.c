@@ -14,6 +14,7 @@ exec(char *path, char **argv)
   char *s, *last;
   int i, off;
   uint argc, sz, sp, ustack[3+MAXARG+1];
+  uint stackbot, stacksize;
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
@@ -63,13 +64,35 @@ exec(char *path, char **argv)
   end_op();
   ip = 0;
 
-  // Allocate two pages at the next page boundary.
-  // Make the first inaccessible.  Use the second as the user stack.
+  // Above the program, an inaccessible guard page and then room
+  // for RLIMIT_STACK of user stack, but no more than USTACKMAX so
+  // that the heap keeps room to grow.  Only the top page of the
+  // stack is allocated now; stackfault() fills in the rest as it is
+  // used, and only the pages it fills in count against RLIMIT_MEM.
   sz = PGROUNDUP(sz);
-  if((sz = allocuvm(pgdir, sz, sz + 2*PGSIZE)) == 0)
+  if(sz + 2*PGSIZE > MMAPBASE)
+    goto bad;
+  stacksize = curproc->rlim[RLIMIT_STACK].cur;
+  if(stacksize > USTACKMAX)
+    stacksize = USTACKMAX;
+  if(stacksize > MMAPBASE - PGSIZE - sz)
+    stacksize = MMAPBASE - PGSIZE - sz;
+  stacksize = PGROUNDUP(stacksize);
+  if(stacksize == 0)
+    stacksize = PGSIZE;
+  if(allocuvm(pgdir, sz, sz + PGSIZE) == 0)
+    goto bad;
+  clearpteu(pgdir, (char*)sz);
+  stackbot = sz + PGSIZE;
+  sz = stackbot + stacksize;
+  if(allocuvm(pgdir, sz - PGSIZE, sz) == 0)
     goto bad;
-  clearpteu(pgdir, (char*)(sz - 2*PGSIZE));
   sp = sz;
+  if(stackbot + PGSIZE > curproc->rlim[RLIMIT_MEM].cur)
+    goto bad;
+
+  if(vdsomap(pgdir, curproc) < 0)
+    goto bad;
 
   // Push argument strings, prepare rest of stack in ustack.
   for(argc = 0; argv[argc]; argc++) {
@@ -94,15 +117,25 @@ exec(char *path, char **argv)
   for(last=s=path; *s; s++)
     if(*s == '/')
       last = s+1;
+  pushcli();
+  procseq(curproc);
   safestrcpy(curproc->name, last, sizeof(curproc->name));
+  procseq(curproc);
+  popcli();
 
   // Commit to the user image.
   oldpgdir = curproc->pgdir;
   curproc->pgdir = pgdir;
   curproc->sz = sz;
+  curproc->stackbot = stackbot;
+  curproc->stacktop = sz;
+  curproc->stacklow = sz - PGSIZE;
+  vmusage(pgdir, &curproc->rss, &curproc->ptpages);
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
+  curproc->ioring = 0;
   switchuvm(curproc);
+  mmapclose(curproc);
   freevm(oldpgdir);
   return 0;
 
@@ -2,3 +2,7 @@
 #define O_WRONLY  0x001
 #define O_RDWR    0x002
 #define O_CREATE  0x200
+
+// mmap() protections
+#define PROT_READ   0x1
+#define PROT_WRITE  0x2
@@ -0,0 +1,39 @@
+// Shared submission/completion ring for batched file and pipe I/O.
+// Visible to both user and kernel space.
+//
+// The ring lives in user memory and is registered once with
+// ioring_setup().  User code fills sq[sqtail % IORING_SIZE] and
+// advances sqtail; ioring_enter() then runs the queued requests in
+// order, posting one completion per request into cq and advancing
+// cqtail.  User code reaps completions from cqhead.
+
+#define IORING_SIZE 64   // entries in each queue
+
+// Operations
+#define IORING_READ   1  // read(fd, addr, len)
+#define IORING_WRITE  2  // write(fd, addr, len)
+#define IORING_OPEN   3  // open((char*)addr, flags)
+#define IORING_CLOSE  4  // close(fd)
+
+struct iosqe {
+  int op;        // IORING_*
+  int fd;
+  uint addr;     // buffer, or path for IORING_OPEN
+  int len;
+  int flags;     // open mode for IORING_OPEN
+  uint data;     // copied to the completion untouched
+};
+
+struct iocqe {
+  uint data;     // from the submission
+  int res;       // what the equivalent system call would return
+};
+
+struct ioring {
+  uint sqhead;   // next submission the kernel takes (kernel writes)
+  uint sqtail;   // next free submission slot (user writes)
+  uint cqhead;   // next completion to reap (user writes)
+  uint cqtail;   // next free completion slot (kernel writes)
+  struct iosqe sq[IORING_SIZE];
+  struct iocqe cq[IORING_SIZE];
+};
@@ -1,6 +1,15 @@
 // Physical memory allocator, intended to allocate
 // memory for user processes, kernel stacks, page table pages,
-// and pipe buffers. Allocates 4096-byte pages.
+// and pipe buffers. Allocates 4096-byte pages, or with
+// kallocpages() physically contiguous runs of 2^order pages.
+//
+// Underneath is a buddy allocator: a free block of 2^k pages
+// starts at a multiple of 2^k pages, and when it is freed while
+// its buddy, the other half of the block of 2^(k+1) pages, is
+// also free, the two are joined.  Single pages come and go
+// through a small cache of free pages that the buddy lists
+// count as in use, so kalloc() and kfree() usually just pop or
+// push a list.
 
 #include "types.h"
 #include "defs.h"
@@ -17,10 +26,32 @@ struct run {
   struct run *next;
 };
 
+// A free block on a buddy list.
+struct block {
+  struct block *next;
+  struct block *prev;
+};
+
+// Idle CPUs keep up to ZPOOL free pages zeroed ahead of time
+// on a list of their own, for kzalloc().
+#define ZPOOL 256
+
+// kfree() keeps up to PCACHE pages for kalloc() before it hands
+// them back to the buddy lists.
+#define PCACHE 64
+
+#define NPAGE (PHYSTOP / PGSIZE)
+
 struct {
   struct spinlock lock;
   int use_lock;
-  struct run *freelist;
+  struct run *freelist;      // page cache
+  int nfree;
+  struct run *zeroed;
+  int nzeroed;
+  struct block *buddy[MAXORDER+1];
+  uchar order[NPAGE];        // 1 + order of the free block starting
+                             // at each page, or 0
 } kmem;
 
 // Initialization happens in two phases.
@@ -49,13 +80,97 @@ freerange(void *vstart, void *vend)
   char *p;
   p = (char*)PGROUNDUP((uint)vstart);
   for(; p + PGSIZE <= (char*)vend; p += PGSIZE)
-    kfree(p);
+    kfreepages(p, 0);
+}
+
+static void
+blockadd(struct block *b, int k)
+{
+  b->prev = 0;
+  b->next = kmem.buddy[k];
+  if(b->next)
+    b->next->prev = b;
+  kmem.buddy[k] = b;
+  kmem.order[V2P(b) / PGSIZE] = k + 1;
+}
+
+static void
+blockremove(struct block *b, int k)
+{
+  if(b->prev)
+    b->prev->next = b->next;
+  else
+    kmem.buddy[k] = b->next;
+  if(b->next)
+    b->next->prev = b->prev;
+  kmem.order[V2P(b) / PGSIZE] = 0;
+}
+
+// Take a block of 2^order pages off the buddy lists, splitting
+// a larger one if need be.  Caller holds kmem.lock.
+static char*
+buddyalloc(int order)
+{
+  struct block *b;
+  int k;
+
+  for(k = order; k <= MAXORDER && kmem.buddy[k] == 0; k++)
+    ;
+  if(k > MAXORDER)
+    return 0;
+  b = kmem.buddy[k];
+  blockremove(b, k);
+  // Give back the upper half until the block is the right size.
+  while(k > order){
+    k--;
+    blockadd((struct block*)((char*)b + (PGSIZE << k)), k);
+  }
+  return (char*)b;
+}
+
+// Put the block of 2^order pages at v on the buddy lists, joining
+// it with its buddy for as long as that is free too.  Caller holds
+// kmem.lock.
+static void
+buddyfree(char *v, int order)
+{
+  uint pn, bn;
+
+  pn = V2P(v) / PGSIZE;
+  for(; order < MAXORDER; order++){
+    bn = pn ^ (1 << order);
+    if(bn >= NPAGE || kmem.order[bn] != order + 1)
+      break;
+    blockremove((struct block*)P2V(bn * PGSIZE), order);
+    pn &= ~(1 << order);
+  }
+  blockadd((struct block*)P2V(pn * PGSIZE), order);
 }
+
+// Give the pages in the cache and the zeroed pool back to the
+// buddy lists, so that they can be joined into larger blocks.
+// Caller holds kmem.lock.
+static void
+kdrain(void)
+{
+  struct run *r;
+
+  while((r = kmem.freelist) != 0){
+    kmem.freelist = r->next;
+    buddyfree((char*)r, 0);
+  }
+  kmem.nfree = 0;
+  while((r = kmem.zeroed) != 0){
+    kmem.zeroed = r->next;
+    buddyfree((char*)r, 0);
+  }
+  kmem.nzeroed = 0;
+}
+
 //PAGEBREAK: 21
 // Free the page of physical memory pointed at by v,
 // which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+// call to kalloc().
 void
 kfree(char *v)
 {
@@ -69,9 +184,13 @@ kfree(char *v)
 
   if(kmem.use_lock)
     acquire(&kmem.lock);
-  r = (struct run*)v;
-  r->next = kmem.freelist;
-  kmem.freelist = r;
+  if(kmem.nfree < PCACHE){
+    r = (struct run*)v;
+    r->next = kmem.freelist;
+    kmem.freelist = r;
+    kmem.nfree++;
+  } else
+    buddyfree(v, 0);
   if(kmem.use_lock)
     release(&kmem.lock);
 }
@@ -87,10 +206,165 @@ kalloc(void)
   if(kmem.use_lock)
     acquire(&kmem.lock);
   r = kmem.freelist;
-  if(r)
+  if(r){
     kmem.freelist = r->next;
+    kmem.nfree--;
+  } else if((r = (struct run*)buddyalloc(0)) == 0 &&
+            (r = kmem.zeroed) != 0){
+    kmem.zeroed = r->next;
+    kmem.nzeroed--;
+  }
   if(kmem.use_lock)
     release(&kmem.lock);
   return (char*)r;
 }
 
+// Allocate 2^order physically contiguous pages, aligned to their
+// size.  Returns 0 if the memory cannot be allocated.
+char*
+kallocpages(int order)
+{
+  char *v;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
+  if(order == 0)
+    return kalloc();
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  if((v = buddyalloc(order)) == 0){
+    kdrain();
+    v = buddyalloc(order);
+  }
+  if(kmem.use_lock)
+    release(&kmem.lock);
+  return v;
+}
+
+// Free 2^order pages from kallocpages().  (Also used to hand
+// memory to the allocator in the first place; see kinit above.)
+void
+kfreepages(char *v, int order)
+{
+  if(order < 0 || order > MAXORDER || (uint)v % (PGSIZE << order) ||
+     v < end || V2P(v) + (PGSIZE << order) > PHYSTOP)
+    panic("kfreepages");
+  memset(v, 1, PGSIZE << order);
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  buddyfree(v, order);
+  if(kmem.use_lock)
+    release(&kmem.lock);
+}
+
+#ifdef KALLOC_TEST
+// Count the free blocks of each order into n.
+static void
+blockcount(int n[])
+{
+  struct block *b;
+  int k;
+
+  for(k = 0; k <= MAXORDER; k++)
+    for(n[k] = 0, b = kmem.buddy[k]; b; b = b->next)
+      n[k]++;
+}
+
+// Test the buddy lists, holding kmem.lock so that idle CPUs filling
+// the zeroed pool cannot change them meanwhile: blocks of a few
+// orders must come back aligned to their size and apart, and freeing
+// them, even in halves, must join them back into the lists as they
+// were.  Panics if not.
+void
+kalloctest(void)
+{
+  static int order[] = { 1, 3, MAXORDER };
+  char *v[NELEM(order)];
+  int before[MAXORDER+1], after[MAXORDER+1];
+  int i, j, k;
+
+  acquire(&kmem.lock);
+  kdrain();
+  blockcount(before);
+  for(i = 0; i < NELEM(order); i++){
+    k = order[i];
+    if((v[i] = buddyalloc(k)) == 0 || V2P(v[i]) % (PGSIZE << k))
+      panic("kalloctest: alloc");
+    for(j = 0; j < i; j++)
+      if(v[i] < v[j] + (PGSIZE << order[j]) &&
+         v[j] < v[i] + (PGSIZE << k))
+        panic("kalloctest: overlap");
+  }
+  for(i = 0; i < NELEM(order); i++){
+    k = order[i] - 1;
+    buddyfree(v[i] + (PGSIZE << k), k);
+    buddyfree(v[i], k);
+  }
+  blockcount(after);
+  for(k = 0; k <= MAXORDER; k++)
+    if(after[k] != before[k])
+      panic("kalloctest: coalesce");
+  release(&kmem.lock);
+  cprintf("kalloctest: ok\n");
+}
+#endif // KALLOC_TEST
+
+// Allocate a page of physical memory filled with zeros,
+// preferably one that an idle CPU has already cleared.
+// Returns 0 if the memory cannot be allocated.
+char*
+kzalloc(void)
+{
+  struct run *r;
+
+  if(kmem.use_lock)
+    acquire(&kmem.lock);
+  r = kmem.zeroed;
+  if(r){
+    kmem.zeroed = r->next;
+    kmem.nzeroed--;
+  }
+  if(kmem.use_lock)
+    release(&kmem.lock);
+  if(r){
+    r->next = 0;
+    return (char*)r;
+  }
+  if((r = (struct run*)kalloc()) != 0)
+    memset(r, 0, PGSIZE);
+  return (char*)r;
+}
+
+// Called by an idle CPU: zero one free page into the pool.
+// Returns 0 if there was nothing to do.
+int
+kzerofill(void)
+{
+  struct run *r;
+
+  // Other CPUs go idle before kinit2() has freed most of memory.
+  if(!kmem.use_lock)
+    return 0;
+  acquire(&kmem.lock);
+  r = 0;
+  if(kmem.nzeroed < ZPOOL){
+    if((r = kmem.freelist) != 0){
+      kmem.freelist = r->next;
+      kmem.nfree--;
+    } else
+      r = (struct run*)buddyalloc(0);
+  }
+  release(&kmem.lock);
+  if(r == 0)
+    return 0;
+
+  memset(r, 0, PGSIZE);
+
+  acquire(&kmem.lock);
+  r->next = kmem.zeroed;
+  kmem.zeroed = r;
+  kmem.nzeroed++;
+  release(&kmem.lock);
+  return 1;
+}
+
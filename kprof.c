@@ -0,0 +1,275 @@
+// Kernel profiler front end.  Drains the samples taken by the
+// timer interrupt (see kprof.h) and symbolizes them against
+// kernel.sym, which the Makefile copies into the file system.
+//
+//   kprof on [n]             sample every n-th tick (default 1)
+//   kprof off                stop sampling
+//   kprof [-g]               report buffered samples; -g adds
+//                            the most common call chains
+//   kprof run [-g] cmd ...   profile while cmd runs, then report
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "kprof.h"
+
+#define KERNBASE 0x80000000
+#define MAXSYM   2048
+#define MAXCHAIN 256
+#define NTOP     20
+#define NSAMPLE  256
+#define CHAINLEN (KPROF_DEPTH+1)
+
+struct sym {
+  uint addr;
+  char *name;
+  uint count;
+};
+
+struct chain {
+  int sym[CHAINLEN];   // symbol indices, pc first; -1 ends the chain
+  uint count;
+};
+
+struct sym syms[MAXSYM];
+int nsym;
+struct chain chains[MAXCHAIN];
+int nchain;
+uint total, user, lost;
+struct kprofsample samples[NSAMPLE];
+
+// Load kernel.sym: one "address name" pair per line.
+static void
+loadsyms(void)
+{
+  struct stat st;
+  struct sym s;
+  char *buf, *p, *q;
+  int fd, i, j;
+  uint a;
+
+  if((fd = open("kernel.sym", O_RDONLY)) < 0 || fstat(fd, &st) < 0){
+    printf(2, "kprof: cannot open kernel.sym\n");
+    exit();
+  }
+  buf = malloc(st.size + 1);
+  if(read(fd, buf, st.size) != st.size){
+    printf(2, "kprof: cannot read kernel.sym\n");
+    exit();
+  }
+  buf[st.size] = 0;
+  close(fd);
+
+  for(p = buf; *p && nsym < MAXSYM; p = q){
+    a = 0;
+    for(q = p; *q && *q != ' '; q++)
+      a = a*16 + (*q >= 'a' ? *q - 'a' + 10 : *q - '0');
+    if(*q == ' ')
+      q++;
+    syms[nsym].name = q;
+    while(*q && *q != '\n')
+      q++;
+    if(*q)
+      *q++ = 0;
+    // Skip file names and anything outside the kernel.
+    if(a < KERNBASE)
+      continue;
+    syms[nsym].addr = a;
+    syms[nsym].count = 0;
+    nsym++;
+  }
+
+  // Sort by address for lookup.
+  for(i = 1; i < nsym; i++){
+    s = syms[i];
+    for(j = i; j > 0 && syms[j-1].addr > s.addr; j--)
+      syms[j] = syms[j-1];
+    syms[j] = s;
+  }
+}
+
+// Index of the symbol containing pc, or -1.
+static int
+lookup(uint pc)
+{
+  int lo, hi, mid;
+
+  if(nsym == 0 || pc < syms[0].addr)
+    return -1;
+  lo = 0;
+  hi = nsym - 1;
+  while(lo < hi){
+    mid = (lo + hi + 1) / 2;
+    if(syms[mid].addr <= pc)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return lo;
+}
+
+static void
+addchain(struct kprofsample *s, int pcsym)
+{
+  int key[CHAINLEN], i, n;
+  struct chain *c;
+
+  key[0] = pcsym;
+  for(n = 1; n < CHAINLEN && s->pcs[n-1]; n++)
+    key[n] = lookup(s->pcs[n-1]);
+  for(i = n; i < CHAINLEN; i++)
+    key[i] = -1;
+
+  for(c = chains; c < &chains[nchain]; c++){
+    for(i = 0; i < CHAINLEN && c->sym[i] == key[i]; i++)
+      ;
+    if(i == CHAINLEN){
+      c->count++;
+      return;
+    }
+  }
+  if(nchain == MAXCHAIN)
+    return;
+  c = &chains[nchain++];
+  for(i = 0; i < CHAINLEN; i++)
+    c->sym[i] = key[i];
+  c->count = 1;
+}
+
+static void
+drain(void)
+{
+  int n, i, k;
+  struct kprofsample *s;
+
+  while((n = kprof(KPROF_READ, samples, NSAMPLE)) > 0){
+    for(i = 0; i < n; i++){
+      s = &samples[i];
+      total++;
+      if(s->eip < KERNBASE){
+        user++;
+        continue;
+      }
+      if((k = lookup(s->eip)) >= 0)
+        syms[k].count++;
+      addchain(s, k);
+    }
+  }
+}
+
+static char*
+symname(int k)
+{
+  return k < 0 ? "?" : syms[k].name;
+}
+
+static void
+report(int callchains)
+{
+  int i, j, k;
+  struct chain *c;
+
+  lost = kprof(KPROF_DROPS, 0, 0);
+  drain();
+  printf(1, "%d samples, %d in user mode", total, user);
+  if(lost)
+    printf(1, ", %d lost to full buffers", lost);
+  printf(1, "\n");
+  if(total == 0)
+    return;
+
+  // The NTOP busiest functions.  Counts are zeroed as they are
+  // printed, which is fine since this is the last use of them.
+  printf(1, "%%\tsamples\tfunction\n");
+  for(i = 0; i < NTOP; i++){
+    k = 0;
+    for(j = 1; j < nsym; j++)
+      if(syms[j].count > syms[k].count)
+        k = j;
+    if(nsym == 0 || syms[k].count == 0)
+      break;
+    printf(1, "%d\t%d\t%s\n", syms[k].count * 100 / total, syms[k].count,
+           syms[k].name);
+    syms[k].count = 0;
+  }
+  if(!callchains)
+    return;
+
+  // The NTOP most common call chains.
+  printf(1, "\nsamples\tcall chain\n");
+  for(i = 0; i < NTOP; i++){
+    c = 0;
+    for(k = 0; k < nchain; k++)
+      if(c == 0 || chains[k].count > c->count)
+        c = &chains[k];
+    if(c == 0 || c->count == 0)
+      break;
+    printf(1, "%d\t%s", c->count, symname(c->sym[0]));
+    for(j = 1; j < CHAINLEN && c->sym[j] != -1; j++)
+      printf(1, " <- %s", symname(c->sym[j]));
+    printf(1, "\n");
+    c->count = 0;
+  }
+}
+
+static void
+run(char **argv)
+{
+  int pid;
+
+  // Throw away whatever an earlier run left behind.
+  while(kprof(KPROF_READ, samples, NSAMPLE) > 0)
+    ;
+  if(kprof(KPROF_ON, 0, 1) < 0){
+    printf(2, "kprof: cannot start sampling\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(2, "kprof: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[0], argv);
+    printf(2, "kprof: exec %s failed\n", argv[0]);
+    exit();
+  }
+  wait();
+  kprof(KPROF_OFF, 0, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int g;
+
+  if(argc >= 2 && strcmp(argv[1], "on") == 0){
+    if(kprof(KPROF_ON, 0, argc > 2 ? atoi(argv[2]) : 1) < 0)
+      printf(2, "kprof: bad interval\n");
+    exit();
+  }
+  if(argc == 2 && strcmp(argv[1], "off") == 0){
+    kprof(KPROF_OFF, 0, 0);
+    exit();
+  }
+
+  g = 0;
+  if(argc >= 2 && strcmp(argv[1], "run") == 0){
+    g = argc > 2 && strcmp(argv[2], "-g") == 0;
+    if(argc < 3 + g){
+      printf(2, "usage: kprof run [-g] cmd [args]\n");
+      exit();
+    }
+    run(argv + 2 + g);
+  } else if(argc == 2 && strcmp(argv[1], "-g") == 0)
+    g = 1;
+  else if(argc != 1){
+    printf(2, "usage: kprof [on [n] | off | -g | run [-g] cmd [args]]\n");
+    exit();
+  }
+
+  loadsyms();
+  report(g);
+  exit();
+}
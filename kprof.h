@@ -0,0 +1,17 @@
+// Kernel sampling profiler (see profile.c).
+// Visible to both user and kernel space.
+
+// Commands for kprof()
+#define KPROF_OFF    0   // stop sampling
+#define KPROF_ON     1   // sample every n-th timer tick
+#define KPROF_READ   2   // move buffered samples into buf
+#define KPROF_DROPS  3   // samples lost to full buffers since KPROF_ON
+
+#define KPROF_DEPTH  4   // return addresses kept per sample
+
+struct kprofsample {
+  uint eip;                // interrupted pc, below KERNBASE if in user mode
+  uint pcs[KPROF_DEPTH];   // kernel callers, innermost first, 0-padded
+  int pid;                 // 0 if the cpu was in its scheduler
+  ushort cpu;
+};
@@ -10,6 +10,10 @@
 #include "mmu.h"
 #include "x86.h"
 
+#ifndef TPS
+#define TPS 100
+#endif
+
 // Local APIC registers, divided by 4 for use as uint[] indices.
 #define ID      (0x0020/4)   // ID
 #define VER     (0x0030/4)   // Version
@@ -42,6 +46,7 @@
 #define TDCR    (0x03E0/4)   // Timer Divide Configuration
 
 volatile uint *lapic;  // Initialized in mp.c
+static uint uscycles;  // TSC cycles per microsecond, see tsccalibrate
 
 //PAGEBREAK!
 static void
@@ -51,6 +56,35 @@ lapicw(int index, int value)
   lapic[ID];  // wait for write to finish, by reading
 }
 
+// Time one period of the timer just programmed with the TSC, so
+// that TSC readings can be turned into real time.  Interrupts are
+// off, so nothing else sees the timer go by.
+static void
+tsccalibrate(void)
+{
+  uint c, last;
+  uint64 t0;
+
+  // Wait for the count to reload, then time until it next does.
+  for(last = lapic[TCCR]; (c = lapic[TCCR]) <= last; last = c)
+    ;
+  t0 = rdtsc();
+  for(last = c; (c = lapic[TCCR]) <= last; last = c)
+    ;
+  uscycles = (uint)(rdtsc() - t0) / (1000000 / TPS);
+  if(uscycles == 0)
+    uscycles = 1;
+}
+
+// Convert a span of TSC cycles to microseconds.
+uint
+tscus(uint64 cycles)
+{
+  if((cycles >> 32) >= uscycles)
+    return 0xffffffff;
+  return divu64(cycles, uscycles);
+}
+
 void
 lapicinit(void)
 {
@@ -71,6 +105,8 @@ lapicinit(void)
 #else
   lapicw(TICR, 10000000);
 #endif // PDX_XV6
+  if(uscycles == 0)
+    tsccalibrate();
 
   // Disable logical interrupt lines.
   lapicw(LINT0, MASKED);
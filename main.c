@@ -28,11 +28,18 @@ main(void)
   uartinit();      // serial port
   pinit();         // process table
   tvinit();        // trap vectors
+  istackinit();    // per-CPU interrupt stacks
+  vdsoinit();      // time page shared with user space
+  kprofinit();     // sampling profiler
+  evtraceinit();   // scheduler event trace
   binit();         // buffer cache
   fileinit();      // file table
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
+#ifdef KALLOC_TEST
+  kalloctest();    // check the buddy allocator
+#endif // KALLOC_TEST
   userinit();      // first user process
   mpmain();        // finish this processor's setup
 }
@@ -81,8 +88,10 @@ startothers(void)
     // Tell entryother.S what stack to use, where to enter, and what
     // pgdir to use. We cannot use kpgdir yet, because the AP processor
     // is running in low  memory, so we use entrypgdir for the APs too.
+    // entrypgdir maps only low memory, so the stack comes from
+    // there rather than kstackalloc(); a page is plenty for scheduler().
     stack = kalloc();
-    *(void**)(code-4) = stack + KSTACKSIZE;
+    *(void**)(code-4) = stack + PGSIZE;
     *(void**)(code-8) = mpenter;
     *(int**)(code-12) = (void *) V2P(entrypgdir);
 
@@ -4,9 +4,14 @@
 #define PHYSTOP 0xE000000           // Top physical memory
 #define DEVSPACE 0xFE000000         // Other devices are at high addresses
 
+// User address space above the heap (see mmap.c)
+#define MMAPBASE 0x40000000         // First address handed out by mmap()
+#define MMAPTOP  0x70000000         // mmap() regions end below this
+
 // Key addresses for address space layout (see kmap in vm.c for layout)
 #define KERNBASE 0x80000000         // First kernel virtual address
 #define KERNLINK (KERNBASE+EXTMEM)  // Address where kernel is linked
+#define KSTACKBASE 0xF0000000       // Kernel stacks (see kstackalloc in vm.c)
 
 #define V2P(a) (((uint) (a)) - KERNBASE)
 #define P2V(a) (((void *) (a)) + KERNBASE)
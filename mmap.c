@@ -0,0 +1,256 @@
+//
+// Memory-mapped files.
+//
+// mmap() reserves a page-aligned range of user addresses between
+// MMAPBASE and MMAPTOP and records it in one of the process's vmas.
+// No memory is allocated up front: the first touch of each page
+// traps into mmapfault(), which reads that page of the file through
+// the buffer cache into a fresh page and maps it.
+//
+// Mappings are private.  A PROT_READ mapping is mapped read-only;
+// a PROT_READ|PROT_WRITE mapping gets writable pages whose changes
+// are never written back to the file, so the file behaves as if
+// it were copied on write.
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "x86.h"
+#include "proc.h"
+#include "fs.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "stat.h"
+#include "fcntl.h"
+
+// Return the vma of p that contains va, or 0.
+static struct vma*
+findvma(struct proc *p, uint va)
+{
+  struct vma *v;
+
+  for(v = p->vmas; v < &p->vmas[NMMAP]; v++)
+    if(v->len && va >= v->addr && va < v->addr + v->len)
+      return v;
+  return 0;
+}
+
+// Find the lowest address at or above MMAPBASE where len bytes
+// fit without overlapping an existing mapping.  Returns 0 if none.
+static uint
+findrange(struct proc *p, uint len)
+{
+  struct vma *v;
+  uint a;
+
+  a = MMAPBASE;
+again:
+  if(a + len > MMAPTOP || a + len < a)
+    return 0;
+  for(v = p->vmas; v < &p->vmas[NMMAP]; v++){
+    if(v->len && a < v->addr + v->len && v->addr < a + len){
+      a = v->addr + v->len;
+      goto again;
+    }
+  }
+  return a;
+}
+
+// Map len bytes of f starting at file offset off into the current
+// process.  Returns the address of the mapping, or -1.
+int
+mmap(struct file *f, int off, int len, int prot)
+{
+  struct proc *curproc = myproc();
+  struct vma *v, *free;
+  uint addr;
+
+  if(off < 0 || off % PGSIZE != 0 || len <= 0)
+    return -1;
+  if(!(prot & PROT_READ) || (prot & ~(PROT_READ|PROT_WRITE)))
+    return -1;
+  if(f->type != FD_INODE || !f->readable || f->ip->type != T_FILE)
+    return -1;
+
+  free = 0;
+  for(v = curproc->vmas; v < &curproc->vmas[NMMAP]; v++)
+    if(v->len == 0){
+      free = v;
+      break;
+    }
+  if(free == 0)
+    return -1;
+
+  len = PGROUNDUP(len);
+  if((addr = findrange(curproc, len)) == 0)
+    return -1;
+
+  free->addr = addr;
+  free->len = len;
+  free->off = off;
+  free->prot = prot;
+  free->f = filedup(f);
+  return addr;
+}
+
+// Remove the mapping of [addr, addr+len).  The range must cover the
+// whole of a region, or its beginning or end; punching a hole in the
+// middle of a region is not supported.
+int
+munmap(uint addr, int len)
+{
+  struct proc *curproc = myproc();
+  struct vma *v;
+  uint end;
+
+  if(addr % PGSIZE != 0 || len <= 0)
+    return -1;
+  if((v = findvma(curproc, addr)) == 0)
+    return -1;
+  end = addr + PGROUNDUP(len);
+  if(end > v->addr + v->len || end < addr)
+    return -1;
+  if(addr != v->addr && end != v->addr + v->len)
+    return -1;
+
+  deallocuvm(curproc->pgdir, end, addr);
+  if(addr == v->addr){
+    v->off += end - addr;
+    v->addr = end;
+  }
+  v->len -= end - addr;
+  if(v->len == 0){
+    fileclose(v->f);
+    v->addr = 0;
+    v->f = 0;
+  }
+  switchuvm(curproc);  // flush stale translations
+  return 0;
+}
+
+// Fill in the page of p containing va from its backing file.
+// err is the hardware page fault error code.
+// Returns 0 if the fault was handled, -1 if va is not mapped
+// or the access is not allowed.
+int
+mmapfault(struct proc *p, uint va, uint err)
+{
+  struct vma *v;
+  char *mem;
+  uint a;
+
+  if((v = findvma(p, va)) == 0)
+    return -1;
+  // The page is there and the access was still refused.
+  if(err & FEC_PR)
+    return -1;
+  if((err & FEC_WR) && !(v->prot & PROT_WRITE))
+    return -1;
+
+  a = PGROUNDDOWN(va);
+  // Whatever lies past the end of the file reads as zeros.
+  if((mem = pagealloc(p->pgdir, 1)) == 0)
+    return -1;
+  ilock(v->f->ip);
+  readi(v->f->ip, mem, v->off + (a - v->addr), PGSIZE);
+  iunlock(v->f->ip);
+
+  if(mappages(p->pgdir, (char*)a, PGSIZE, V2P(mem),
+              PTE_U | ((v->prot & PROT_WRITE) ? PTE_W : 0)) < 0){
+    kfree(mem);
+    vmcount(p->pgdir, VM_PGFREE);
+    return -1;
+  }
+  memacct(p->pgdir, 1, 0);
+  return 0;
+}
+
+// Check that [va, va+n) lies within one of p's mappings, writable
+// if write is set, and bring in any of its pages not yet read or
+// swapped out, so that the kernel can use them without faulting.
+// Returns 0 if it did, or -1.
+int
+mmapfill(struct proc *p, uint va, uint n, int write)
+{
+  struct vma *v;
+  pte_t *pte;
+  uint a;
+
+  if((v = findvma(p, va)) == 0 || va + n < va || va + n > v->addr + v->len)
+    return -1;
+  if(write && !(v->prot & PROT_WRITE))
+    return -1;
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+    if((pte = walkpgdir(p->pgdir, (char*)a, 0)) != 0 && (*pte & PTE_P))
+      continue;
+    if(pte && (*pte & PTE_SWAP)){
+      if(swapin(p->pgdir, a) < 0)
+        return -1;
+    } else if(mmapfault(p, a, write ? FEC_WR : 0) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Return the lowest address at or above va that lies in one of p's
+// mappings, or 0 if there is none.
+uint
+mmapnext(struct proc *p, uint va)
+{
+  struct vma *v;
+  uint a;
+
+  a = 0;
+  for(v = p->vmas; v < &p->vmas[NMMAP]; v++){
+    if(v->len == 0 || v->addr + v->len <= va)
+      continue;
+    if(va >= v->addr)
+      return va;
+    if(a == 0 || v->addr < a)
+      a = v->addr;
+  }
+  return a;
+}
+
+// Give np copies of p's mappings, including the pages p has
+// already touched.  Returns -1, leaving np with no mappings,
+// if memory runs out.
+int
+mmapdup(struct proc *np, struct proc *p)
+{
+  int i;
+
+  for(i = 0; i < NMMAP; i++){
+    if(p->vmas[i].len == 0)
+      continue;
+    np->vmas[i] = p->vmas[i];
+    filedup(np->vmas[i].f);
+    if(copyuvmrange(np->pgdir, p->pgdir, p->vmas[i].addr,
+                    p->vmas[i].addr + p->vmas[i].len) < 0){
+      mmapclose(np);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// Drop all of p's mappings.  The pages themselves are left in
+// p->pgdir and go away with it in freevm().
+void
+mmapclose(struct proc *p)
+{
+  struct vma *v;
+
+  for(v = p->vmas; v < &p->vmas[NMMAP]; v++){
+    if(v->len == 0)
+      continue;
+    fileclose(v->f);
+    v->addr = 0;
+    v->len = 0;
+    v->f = 0;
+  }
+}
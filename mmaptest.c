@@ -0,0 +1,230 @@
+// Test of mmap() and munmap().
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define NPAGES 3
+#define PAGE 4096
+
+char buf[PAGE];
+
+static void
+fail(char *msg)
+{
+  printf(1, "mmaptest: FAILED: %s\n", msg);
+  unlink("mmap.dat");
+  exit();
+}
+
+// Byte i of the test file.
+static char
+expect(int i)
+{
+  return 'a' + (i / 7) % 26;
+}
+
+static void
+makefile(void)
+{
+  int fd, i, n;
+
+  if((fd = open("mmap.dat", O_CREATE|O_RDWR)) < 0)
+    fail("create mmap.dat");
+  // The last page is only half full.
+  for(n = 0; n < NPAGES; n++){
+    for(i = 0; i < PAGE; i++)
+      buf[i] = expect(n*PAGE + i);
+    if(write(fd, buf, n == NPAGES-1 ? PAGE/2 : PAGE) < 0)
+      fail("write mmap.dat");
+  }
+  close(fd);
+}
+
+static void
+readonlytest(void)
+{
+  int fd, i, pid;
+  char *p;
+
+  printf(1, "read-only mapping\n");
+  if((fd = open("mmap.dat", O_RDONLY)) < 0)
+    fail("open mmap.dat");
+  p = mmap(fd, 0, NPAGES*PAGE, PROT_READ);
+  if(p == (char*)-1)
+    fail("mmap");
+  close(fd);  // the mapping keeps the file open
+
+  // Touch pages out of order.
+  for(i = NPAGES*PAGE/2 - 1; i >= 0; i -= 97)
+    if(p[i] != expect(i))
+      fail("wrong byte in mapping");
+  for(i = NPAGES*PAGE/2; i < (NPAGES-1)*PAGE + PAGE/2; i++)
+    if(p[i] != expect(i))
+      fail("wrong byte in mapping");
+  for(; i < NPAGES*PAGE; i++)
+    if(p[i] != 0)
+      fail("bytes past end of file not zero");
+
+  // A store must kill the process.
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0){
+    p[0] = 'x';
+    printf(1, "mmaptest: FAILED: store to read-only mapping\n");
+    exit();
+  }
+  wait();
+
+  if(munmap(p, NPAGES*PAGE) < 0)
+    fail("munmap");
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0){
+    if(p[0] == expect(0))
+      printf(1, "mmaptest: FAILED: load after munmap\n");
+    exit();
+  }
+  wait();
+  printf(1, "read-only mapping ok\n");
+}
+
+static void
+privatetest(void)
+{
+  int fd, i, pid;
+  char *p;
+
+  printf(1, "private mapping\n");
+  if((fd = open("mmap.dat", O_RDONLY)) < 0)
+    fail("open mmap.dat");
+  p = mmap(fd, PAGE, 2*PAGE, PROT_READ|PROT_WRITE);
+  if(p == (char*)-1)
+    fail("mmap");
+
+  for(i = 0; i < PAGE; i++)
+    p[i] = 'z';
+  if(p[PAGE] != expect(2*PAGE))
+    fail("wrong byte at offset");
+
+  // The child sees the parent's changes; the parent does not see
+  // the child's.
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0){
+    if(p[0] != 'z' || p[PAGE] != expect(2*PAGE))
+      printf(1, "mmaptest: FAILED: child mapping differs\n");
+    p[1] = 'y';
+    exit();
+  }
+  wait();
+  if(p[1] != 'z')
+    fail("child store visible in parent");
+
+  // Writes to a private mapping never reach the file.
+  if(read(fd, buf, PAGE) != PAGE || read(fd, buf, PAGE) != PAGE)
+    fail("read mmap.dat");
+  if(buf[0] != expect(PAGE))
+    fail("private store reached the file");
+  close(fd);
+
+  // Unmap the front page, then the rest.
+  if(munmap(p, PAGE) < 0)
+    fail("munmap front");
+  if(p[PAGE] != expect(2*PAGE))
+    fail("tail of mapping lost");
+  if(munmap(p + PAGE, PAGE) < 0)
+    fail("munmap tail");
+  if(munmap(p + PAGE, PAGE) == 0)
+    fail("munmap of unmapped range");
+  printf(1, "private mapping ok\n");
+}
+
+// Mapped memory works as a system call buffer, before and after
+// it has been touched.
+static void
+syscalltest(void)
+{
+  int fd, fds[2], i;
+  char *p, *q;
+
+  printf(1, "system call buffers\n");
+  if((fd = open("mmap.dat", O_RDONLY)) < 0)
+    fail("open mmap.dat");
+  p = mmap(fd, 0, 2*PAGE, PROT_READ);
+  q = mmap(fd, 0, PAGE, PROT_READ|PROT_WRITE);
+  if(p == (char*)-1 || q == (char*)-1)
+    fail("mmap");
+  if(pipe(fds) < 0)
+    fail("pipe");
+
+  // write() from a page not yet read in, and from one that was.
+  if(write(fds[1], p + PAGE, 100) != 100 || read(fds[0], buf, 100) != 100)
+    fail("write from mapping");
+  for(i = 0; i < 100; i++)
+    if(buf[i] != expect(PAGE + i))
+      fail("wrong bytes written from mapping");
+  if(p[0] != expect(0) || write(fds[1], p, 100) != 100 ||
+     read(fds[0], buf, 100) != 100 || buf[99] != expect(99))
+    fail("write from touched mapping");
+
+  // read() into a writable mapping, but not a read-only one.
+  if(write(fds[1], "hello", 5) != 5 || read(fds[0], q + 10, 5) != 5)
+    fail("read into writable mapping");
+  if(q[9] != expect(9) || q[10] != 'h' || q[14] != 'o')
+    fail("wrong bytes read into mapping");
+  if(read(fd, p, 10) >= 0)
+    fail("read into read-only mapping allowed");
+  // Nor past the end of a mapping.
+  if(write(fds[1], p + PAGE, PAGE + 1) >= 0)
+    fail("write past end of mapping allowed");
+
+  close(fds[0]);
+  close(fds[1]);
+  close(fd);
+  munmap(p, 2*PAGE);
+  munmap(q, PAGE);
+  printf(1, "system call buffers ok\n");
+}
+
+static void
+badargstest(void)
+{
+  int fd;
+
+  printf(1, "bad arguments\n");
+  if((fd = open("mmap.dat", O_RDONLY)) < 0)
+    fail("open mmap.dat");
+  if(mmap(fd, 1, PAGE, PROT_READ) != (char*)-1)
+    fail("unaligned offset accepted");
+  if(mmap(fd, 0, 0, PROT_READ) != (char*)-1)
+    fail("zero length accepted");
+  if(mmap(fd, 0, PAGE, PROT_WRITE) != (char*)-1)
+    fail("write-only mapping accepted");
+  if(mmap(fd + 1, 0, PAGE, PROT_READ) != (char*)-1)
+    fail("bad fd accepted");
+  close(fd);
+  if((fd = open(".", O_RDONLY)) < 0)
+    fail("open .");
+  if(mmap(fd, 0, PAGE, PROT_READ) != (char*)-1)
+    fail("directory mapping accepted");
+  close(fd);
+  printf(1, "bad arguments ok\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  makefile();
+  readonlytest();
+  privatetest();
+  syscalltest();
+  badargstest();
+  unlink("mmap.dat");
+  printf(1, "mmaptest: ALL TESTS PASSED\n");
+  exit();
+}
@@ -1,7 +1,12 @@
-#define NPROC        64  // maximum number of processes
-#define KSTACKSIZE 4096  // size of per-process kernel stack
+#define NPROC        64  // default limit on processes, see maxproc()
+#define NPROCMAX   4096  // highest the limit can be raised
+#define KSTACKSIZE (4*4096)  // size of per-process kernel stack
+#define MAXORDER     10  // kallocpages() blocks are at most 2^MAXORDER pages
+#define USTACKSIZE (256*4096)  // default RLIMIT_STACK, in bytes
+#define USTACKMAX (4096*4096)  // most user stack exec() sets aside
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
+#define NMMAP         8  // memory-mapped regions per process
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
@@ -10,6 +15,7 @@
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
 #define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
+#define SWAPPAGES  1024  // pages of swap space after the file system
 #ifdef PDX_XV6
 #define FSSIZE       2000  // size of file system in blocks
 #else
@@ -6,12 +6,16 @@
 #ifdef CS333_P2
 #define DEFAULT_UID 0
 #define DEFAULT_GID 0
+#define MAXUIDGID 32767  // uids and gids run from 0 to MAXUIDGID
 #endif
 
 #ifdef CS333_P4
 #define MAXPRIO 6
-#define DEFAULT_BUDGET 10
+#define DEFAULT_BUDGET (10 * 1000000 / TPS)  // microseconds, 10 ticks
 #define TICKS_TO_PROMOTE 1000
+#define STRIDE1 (1 << 16)   // stride of a one-ticket process
+#define MAXTICKETS 1000
+#define MLFQ_TICKETS 100    // share of the MLFQ class as a whole
 #endif
 
 #ifndef PDX_INCLUDE
@@ -30,8 +34,6 @@
 #define TPS 1000   // ticks-per-second
 #define SCHED_INTERVAL (TPS/100)  // see trap.c
 
-#define NPROC  64  // maximum number of processes -- normally in param.h
-
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #define max(a, b) ((a) > (b) ? (a) : (b))
 
@@ -0,0 +1,143 @@
+#ifdef CS333_P4
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+#include "stat.h"
+
+// Check that a sleeplock holder inherits the priority of its
+// waiters.
+//
+// A low-priority writer rewrites a file larger than the buffer
+// cache, so it spends much of its time holding the file's inode
+// lock while it waits for the disk.  NHOG CPU-bound children are
+// kept just below MAXPRIO, where they starve the writer.  A
+// MAXPRIO child repeatedly fstat()s the file, which needs the same
+// inode lock.  Without priority inheritance, whenever the writer
+// is starved while holding the lock the fstat() waits until the
+// writer is next let run, a PHASE later.  With it, the writer runs
+// at MAXPRIO until it lets go.  The test needs NHOG to be at least
+// the number of CPUs.
+
+#define NHOG    4
+#define PHASES  20
+#define PHASE   100          // ticks between chances for the writer
+#define RUNL    5            // ticks the writer gets at MAXPRIO
+#define LIMIT   (PHASE / 4)  // longest acceptable fstat(), in ticks
+#define FSIZE   (64 * 512)   // twice the buffer cache
+
+char *file = "pitest.dat";
+char buf[FSIZE];
+int hogs[NHOG];
+
+static int
+spawn(void (*fn)(void))
+{
+  int pid;
+
+  pid = fork();
+  if(pid < 0){
+    printf(2, "pitest: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    fn();
+    exit();
+  }
+  return pid;
+}
+
+static void
+hog(void)
+{
+  for(;;)
+    ;
+}
+
+static void
+writer(void)
+{
+  int fd;
+
+  for(;;){
+    if((fd = open(file, O_RDWR)) < 0)
+      exit();
+    write(fd, buf, FSIZE);
+    close(fd);
+  }
+}
+
+int end, fds[2];
+
+// Time fstat() until end, then report the longest one.
+static void
+waiter(void)
+{
+  struct stat st;
+  int fd, t, max;
+
+  if((fd = open(file, O_RDONLY)) < 0)
+    exit();
+  max = 0;
+  while(uptime() < end){
+    setpriority(getpid(), MAXPRIO);
+    t = uptime();
+    fstat(fd, &st);
+    t = uptime() - t;
+    if(t > max)
+      max = t;
+    sleep(1);
+  }
+  write(fds[1], &max, sizeof(max));
+}
+
+int
+main(void)
+{
+  int fd, i, t, max, lpid, start;
+
+  if((fd = open(file, O_CREATE|O_RDWR)) < 0 ||
+     write(fd, buf, FSIZE) != FSIZE){
+    printf(2, "pitest: cannot create %s\n", file);
+    exit();
+  }
+  close(fd);
+  if(pipe(fds) < 0){
+    printf(2, "pitest: pipe failed\n");
+    exit();
+  }
+
+  start = uptime();
+  end = start + PHASES * PHASE;
+  setpriority(getpid(), MAXPRIO);
+  lpid = spawn(writer);
+  for(i = 0; i < NHOG; i++)
+    hogs[i] = spawn(hog);
+  spawn(waiter);
+
+  // Hold the hogs just under MAXPRIO against demotion, and let
+  // the writer run briefly at the start of each phase.
+  while((t = uptime()) < end){
+    setpriority(getpid(), MAXPRIO);
+    for(i = 0; i < NHOG; i++)
+      setpriority(hogs[i], MAXPRIO - 1);
+    setpriority(lpid, (t - start) % PHASE < RUNL ? MAXPRIO : 0);
+    sleep(1);
+  }
+
+  for(i = 0; i < NHOG; i++)
+    kill(hogs[i]);
+  kill(lpid);
+  if(read(fds[0], &max, sizeof(max)) != sizeof(max))
+    max = -1;
+  while(wait() != -1)
+    ;
+  unlink(file);
+
+  printf(1, "longest fstat() behind the writer: %d ticks\n", max);
+  if(max < 0 || max > LIMIT)
+    printf(1, "pitest: FAILED: priority inversion (limit %d ticks)\n", LIMIT);
+  else
+    printf(1, "pitest: PASSED\n");
+  exit();
+}
+#endif
@@ -6,6 +6,9 @@
 #include "x86.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "sleeplock.h"
+#include "schedtrace.h"
+#include "cpustat.h"
 #ifdef CS333_P2
 #include "uproc.h"
 #endif
@@ -30,15 +33,26 @@ struct ptrs {
 };
 #endif  //CS333_P3
 
+#define NPIDHASH 64  // buckets in ptable.pidhash, a power of 2
+
 static struct {
   struct spinlock lock;
-  struct proc proc[NPROC];
+  struct proc *slot[NPROCMAX];  // every descriptor made, see procnew()
+  int nslot;                    // descriptors made so far
+  int maxproc;                  // limit on nslot, see maxproc()
+  struct proc *all;             // processes in use, by p->anext
+  struct proc *pidhash[NPIDHASH];  // processes in use, by p->hnext
 #ifdef CS333_P3
   struct ptrs list[statecount];
 #endif  //CS333_P3
 #ifdef CS333_P4
-  struct ptrs ready[MAXPRIO + 1];
+  struct ptrs ready[MAXPRIO + 1];  // see readylist()
+  uint rot;            // rotation of ready[], see readylist()
+  uint epoch;          // promotions so far
   uint PromoteAtTime;
+  struct ptrs stride;  // RUNNABLE processes in the stride class
+  uint64 mlfqpass;     // pass of the MLFQ class as a whole
+  uint64 vtime;        // pass of the last client picked to run
 #endif  //CS333_P4
 } ptable;
 
@@ -51,16 +65,24 @@ static void wakeup1(void* chan);
 
 #ifdef CS333_P3
 static void initProcessLists(void);
-static void initFreeList(void);
 static void stateListAdd(struct ptrs*, struct proc*);
 static int stateListRemove(struct ptrs*, struct proc* p);
 static void assertState(struct proc*, enum procstate, const char *, int);
 #endif  //CS333_P3
+#ifdef CS333_P4
+static void readyAdd(struct proc*);
+static struct ptrs* readyq(struct proc*);
+static struct ptrs* readylist(uint);
+static uint effprio(struct proc*);
+static uint schedprio(struct proc*);
+static void catchup(struct proc*);
+#endif  //CS333_P4
 
 void
 pinit(void)
 {
   initlock(&ptable.lock, "ptable");
+  ptable.maxproc = NPROC;
 }
 
 // Must be called with interrupts disabled
@@ -103,8 +125,117 @@ myproc(void) {
   return p;
 }
 
+// Called before and after a change to p that procquery() must
+// not see half done, such as freeing the slot, so that p->seq
+// is odd in between.  The caller keeps anyone else from
+// changing p at the same time and cannot be rescheduled.
+void
+procseq(struct proc *p)
+{
+  __sync_synchronize();
+  p->seq++;
+  __sync_synchronize();
+}
+
+// Make a new process descriptor if the limit allows, carved
+// from a page set aside for them.  Descriptors are never freed,
+// only reused, so a pointer to one always points at a struct
+// proc; procquery() relies on this to read them without
+// ptable.lock.  Caller holds ptable.lock.
+static struct proc*
+procnew(void)
+{
+  static char *next, *end;
+  struct proc *p;
+
+  if(ptable.nslot >= ptable.maxproc)
+    return 0;
+  if(next + sizeof(*p) > end){
+    if((next = kzalloc()) == 0){
+      end = 0;
+      return 0;
+    }
+    end = next + PGSIZE;
+  }
+  p = (struct proc*)next;
+  next += sizeof(*p);
+  ptable.slot[ptable.nslot] = p;
+  __sync_synchronize();
+  ptable.nslot++;
+  return p;
+}
+
+// Enter p, which has just been given its pid, on the list of
+// processes in use and in the pid hash.  Caller holds ptable.lock.
+static void
+proclink(struct proc *p)
+{
+  struct proc **h = &ptable.pidhash[p->pid & (NPIDHASH - 1)];
+
+  p->aprev = 0;
+  p->anext = ptable.all;
+  if(ptable.all)
+    ptable.all->aprev = p;
+  ptable.all = p;
+  p->hnext = *h;
+  *h = p;
+}
+
+// Undo proclink() for p, which is being made UNUSED.
+// Caller holds ptable.lock.
+static void
+procunlink(struct proc *p)
+{
+  struct proc **h;
+
+  if(p->aprev)
+    p->aprev->anext = p->anext;
+  else
+    ptable.all = p->anext;
+  if(p->anext)
+    p->anext->aprev = p->aprev;
+  for(h = &ptable.pidhash[p->pid & (NPIDHASH - 1)]; *h; h = &(*h)->hnext)
+    if(*h == p){
+      *h = p->hnext;
+      break;
+    }
+  p->anext = p->aprev = p->hnext = 0;
+}
+
+// The process in use with the given pid, or 0.
+// Caller holds ptable.lock.
+static struct proc*
+findproc(int pid)
+{
+  struct proc *p;
+
+  for(p = ptable.pidhash[pid & (NPIDHASH - 1)]; p; p = p->hnext)
+    if(p->pid == pid)
+      return p;
+  return 0;
+}
+
+// Return the limit on the number of processes, after first
+// setting it to n if n > 0.  It goes no higher than NPROCMAX,
+// nor lower than the number of descriptors already made.
+int
+maxproc(int n)
+{
+  acquire(&ptable.lock);
+  if(n > 0){
+    if(n > NPROCMAX)
+      n = NPROCMAX;
+    if(n < ptable.nslot)
+      n = ptable.nslot;
+    ptable.maxproc = n;
+  }
+  n = ptable.maxproc;
+  release(&ptable.lock);
+  return n;
+}
+
 //PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
+// Find an UNUSED proc, or make one.
 // If found, change state to EMBRYO and initialize
 // state required to run in the kernel.
 // Otherwise return 0.
@@ -113,62 +244,76 @@ allocproc(void)
 {
   struct proc *p;
   char *sp;
+  int i;
 
   acquire(&ptable.lock);
 
 #ifdef CS333_P3
   p = ptable.list[UNUSED].head;
-  if (!p) {
+  if(p && stateListRemove(&ptable.list[p->state], p) < 0)
+    panic("Process not found when removing from state list (allocproc)");
+  if(!p && !(p = procnew())) {
     release(&ptable.lock);
     return 0;
   }
-  if(stateListRemove(&ptable.list[p->state], p) < 0)
-    panic("Process not found when removing from state list (allocproc)");
   assertState(p, UNUSED, __FUNCTION__, __LINE__);
   p->state = EMBRYO;
   stateListAdd(&ptable.list[p->state], p);
 
 #else
-  int found = 0;
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == UNUSED) {
-      found = 1;
+  for(i = 0; i < ptable.nslot; i++)
+    if(ptable.slot[i]->state == UNUSED)
       break;
-    }
-  if (!found) {
+  if(i < ptable.nslot)
+    p = ptable.slot[i];
+  else if(!(p = procnew())) {
     release(&ptable.lock);
     return 0;
   }
   p->state = EMBRYO;
 #endif
   p->pid = nextpid++;
+  proclink(p);
+  p->affinity = ~0;
+  p->lastcpu = -1;
+  memset(p->vmev, 0, sizeof(p->vmev));
+  for(i = 0; i < NRLIMIT; i++)
+    p->rlim[i].cur = p->rlim[i].max = RLIM_INFINITY;
+  p->rlim[RLIMIT_STACK].cur = USTACKSIZE;
+  p->rlim[RLIMIT_STACK].max = USTACKMAX;
 
   //Set the amount of time that the process has been both scheduled
   //and running in the cpu to 0.
 #ifdef CS333_P2
-  p->cpu_ticks_total = 0;
-  p->cpu_ticks_in = 0;
+  p->cpu_cycles_total = 0;
+  p->cpu_cycles_in = 0;
 #endif  //CS333_P2
 
 #ifdef CS333_P4
   p->prio = MAXPRIO;
+  p->epoch = ptable.epoch;
   p->budget = DEFAULT_BUDGET;
+  p->tickets = 0;
+  p->pass = 0;
+  p->inherit = -1;
+  p->waitlock = 0;
 #endif  //CS333_P4
 
   release(&ptable.lock);
 
   // Allocate kernel stack.
-  if((p->kstack = kalloc()) == 0){
-#ifdef CS333_P3
+  if((p->kstack = kstackalloc()) == 0){
     acquire(&ptable.lock);
+    procunlink(p);
+#ifdef CS333_P3
     stateListRemove(&ptable.list[p->state], p);
     assertState(p, EMBRYO, __FUNCTION__, __LINE__);
     p->state = UNUSED;
     stateListAdd(&ptable.list[p->state], p);
-    release(&ptable.lock);
 #else
     p->state = UNUSED;
 #endif  //CS333_P3
+    release(&ptable.lock);
     return 0;
   }
   sp = p->kstack + KSTACKSIZE;
@@ -206,7 +351,6 @@ userinit(void)
 #ifdef CS333_P3
   acquire(&ptable.lock);
   initProcessLists();
-  initFreeList();
 
 #ifdef CS333_P4
   ptable.PromoteAtTime = ticks + TICKS_TO_PROMOTE;
@@ -235,6 +379,9 @@ userinit(void)
   p->uid = DEFAULT_UID;
   p->gid = DEFAULT_GID;
 #endif  //CS333_P2
+  if(vdsomap(p->pgdir, p) < 0)
+    panic("userinit: out of memory?");
+  vmusage(p->pgdir, &p->rss, &p->ptpages);
 
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
@@ -251,7 +398,7 @@ userinit(void)
   assertState(p, EMBRYO, __FUNCTION__, __LINE__);
   p->state = RUNNABLE;
 #ifdef CS333_P4
-  stateListAdd(&ptable.ready[p->prio], p);
+  readyAdd(p);
 #else
   stateListAdd(&ptable.list[p->state], p);
 #endif
@@ -272,9 +419,18 @@ growproc(int n)
 
   sz = curproc->sz;
   if(n > 0){
+    if(sz + n > MMAPBASE)  // heap would run into mmap() regions
+      return -1;
+    if(memuse(curproc, sz + n, curproc->stacklow) >
+       curproc->rlim[RLIMIT_MEM].cur)
+      return -1;
     if((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
   } else if(n < 0){
+    // The heap may not shrink into the stack region above it,
+    // whose pages stackfault() would otherwise map past sz.
+    if(0U - (uint)n > sz - curproc->stacktop)
+      return -1;
     if((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
       return -1;
   }
@@ -283,6 +439,92 @@ growproc(int n)
   return 0;
 }
 
+#ifdef CS333_P2
+// Called on each timer tick: kill the current process once the CPU
+// time it has been charged, plus its run so far, passes RLIMIT_CPU.
+void
+cpulimit(void)
+{
+  struct proc *p = myproc();
+  uint lim;
+  uint64 cycles;
+
+  lim = p->rlim[RLIMIT_CPU].cur;
+  if(lim == RLIM_INFINITY)
+    return;
+  cycles = p->cpu_cycles_total + (rdtsc() - p->cpu_cycles_in);
+  // Millions of cycles over cycles per microsecond is seconds.
+  if(tscus(divu64(cycles, 1000000)) >= lim)
+    p->killed = 1;
+}
+#endif  //CS333_P2
+
+// Clock hand for evict(): the descriptor slot and the address in
+// it that the scan resumes from.
+static struct {
+  int i;
+  uint va;
+} hand;
+
+// Choose a user page to swap out by second chance: sweep the pages
+// of every process, those below sz and then those of its mmap()
+// regions, clearing PTE_A on those used since the last sweep and
+// taking the first one found that was not.  Its contents are copied
+// to buf, its frame is freed and its PTE records slot.
+// Returns 0, or -1 if no page can be taken.
+//
+// Only processes preempted in user mode (p->swapok) that have not
+// yet been picked to run again are candidates.  They have no TLB
+// entries on any CPU, and will fault the page back in before they
+// or the kernel on their behalf touch it.  ptable.lock keeps them
+// from running during the scan.
+int
+evict(char *buf, uint slot)
+{
+  struct proc *p;
+  pte_t *pte;
+  char *mem;
+  int n;
+
+  acquire(&ptable.lock);
+  // Two full sweeps: the first may only clear PTE_A bits.
+  for(n = 0; n <= 2*ptable.nslot; n++){
+    if(hand.i >= ptable.nslot)
+      hand.i = 0;
+    p = ptable.slot[hand.i];
+    if(p->swapok && p->state == RUNNABLE){
+      for(;; hand.va += PGSIZE){
+        if(hand.va >= p->sz && (hand.va = mmapnext(p, hand.va)) == 0)
+          break;
+        if((pte = walkpgdir(p->pgdir, (char*)hand.va, 0)) == 0){
+          hand.va = PGADDR(PDX(hand.va) + 1, 0, 0) - PGSIZE;
+          continue;
+        }
+        // Pages without PTE_U, like the stack guard, stay put.
+        if((*pte & (PTE_P|PTE_U)) != (PTE_P|PTE_U))
+          continue;
+        if(*pte & PTE_A){
+          *pte &= ~PTE_A;
+          continue;
+        }
+        mem = P2V(PTE_ADDR(*pte));
+        memmove(buf, mem, PGSIZE);
+        kfree(mem);
+        *pte = (slot << PGSHIFT) | PTE_SWAP | (*pte & (PTE_W|PTE_U));
+        p->rss--;
+        p->vmev[VM_SWAPOUT]++;
+        hand.va += PGSIZE;
+        release(&ptable.lock);
+        return 0;
+      }
+    }
+    hand.i++;
+    hand.va = 0;
+  }
+  release(&ptable.lock);
+  return -1;
+}
+
 // Create a new process copying p as the parent.
 // Sets up stack to return as if from system call.
 // Caller must set state of returned proc to RUNNABLE.
@@ -300,24 +542,40 @@ fork(void)
   }
 
   // Copy process state from proc.
-  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0){
-    kfree(np->kstack);
+  if((np->pgdir = copyuvm(curproc->pgdir, curproc->sz)) == 0 ||
+     mmapdup(np, curproc) < 0 || vdsomap(np->pgdir, np) < 0){
+    if(np->pgdir){
+      freevm(np->pgdir);
+      np->pgdir = 0;
+    }
+    if(np->vdso){
+      kfree(np->vdso);
+      np->vdso = 0;
+    }
+    kstackfree(np->kstack);
     np->kstack = 0;
-#ifdef CS333_P3
     acquire(&ptable.lock);
+    procunlink(np);
+#ifdef CS333_P3
     if(stateListRemove(&ptable.list[np->state], np) < 0)
       panic("Process not found when removing from state list (fork)");
     assertState(np, EMBRYO, __FUNCTION__, __LINE__);
     np->state = UNUSED;
     stateListAdd(&ptable.list[np->state], np);
-    release(&ptable.lock);
 #else
     np->state = UNUSED;
 #endif
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
+  np->stackbot = curproc->stackbot;
+  np->stacktop = curproc->stacktop;
+  np->stacklow = curproc->stacklow;
+  vmusage(np->pgdir, &np->rss, &np->ptpages);
+  memmove(np->rlim, curproc->rlim, sizeof(np->rlim));
   np->parent = curproc;
+  np->ioring = curproc->ioring;
   *np->tf = *curproc->tf;
 
   //Add the copying process for the UID and GID for project 2.
@@ -325,6 +583,15 @@ fork(void)
   np->uid = curproc->uid;
   np->gid = curproc->gid;
 #endif  //CS333_P2
+  np->affinity = curproc->affinity;
+#ifdef CS333_P4
+  // A stride process's children share its scheduling class.
+  np->tickets = curproc->tickets;
+  np->stride = curproc->stride;
+  np->pass = curproc->pass;
+#endif  //CS333_P4
+
+  vdsosetproc(np);
 
   // Clear %eax so that fork returns 0 in the child.
   np->tf->eax = 0;
@@ -346,7 +613,7 @@ fork(void)
   assertState(np, EMBRYO, __FUNCTION__, __LINE__);
   np->state = RUNNABLE;
 #ifdef CS333_P4
-  stateListAdd(&ptable.ready[np->prio], np);
+  readyAdd(np);
 #else
   stateListAdd(&ptable.list[np->state], np);
 #endif
@@ -380,6 +647,7 @@ exit(void)
       curproc->ofile[fd] = 0;
     }
   }
+  mmapclose(curproc);
 
   begin_op();
   iput(curproc->cwd);
@@ -392,9 +660,10 @@ exit(void)
   wakeup1(curproc->parent);
 
   // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  for(p = ptable.all; p; p = p->anext){
     if(p->parent == curproc){
       p->parent = initproc;
+      vdsosetproc(p);
       if(p->state == ZOMBIE)
         wakeup1(initproc);
     }
@@ -431,6 +700,7 @@ exit(void)
       curproc->ofile[fd] = 0;
     }
   }
+  mmapclose(curproc);
 
   begin_op();
   iput(curproc->cwd);
@@ -443,9 +713,10 @@ exit(void)
   wakeup1(curproc->parent);
 
   // Pass abandoned children to init.
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+  for(p = ptable.all; p; p = p->anext){
     if(p->parent == curproc){
       p->parent = initproc;
+      vdsosetproc(p);
       if(p->state == ZOMBIE)
         wakeup1(initproc);
     }
@@ -476,16 +747,20 @@ wait(void)
   for(;;){
     // Scan through table looking for exited children.
     havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    for(p = ptable.all; p; p = p->anext){
       if(p->parent != curproc)
         continue;
       havekids = 1;
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
-        kfree(p->kstack);
+        procseq(p);
+        procunlink(p);
+        kstackfree(p->kstack);
         p->kstack = 0;
         freevm(p->pgdir);
+        kfree(p->vdso);
+        p->vdso = 0;
         p->pid = 0;
         p->parent = 0;
         p->name[0] = 0;
@@ -499,6 +774,7 @@ wait(void)
         assertState(p, ZOMBIE, __FUNCTION__, __LINE__);
         p->state = UNUSED;
         stateListAdd(&ptable.list[p->state], p);
+        procseq(p);
         release(&ptable.lock);
         return pid;
       }
@@ -527,21 +803,26 @@ wait(void)
   for(;;){
     // Scan through table looking for exited children.
     havekids = 0;
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
+    for(p = ptable.all; p; p = p->anext){
       if(p->parent != curproc)
         continue;
       havekids = 1;
       if(p->state == ZOMBIE){
         // Found one.
         pid = p->pid;
-        kfree(p->kstack);
+        procseq(p);
+        procunlink(p);
+        kstackfree(p->kstack);
         p->kstack = 0;
         freevm(p->pgdir);
+        kfree(p->vdso);
+        p->vdso = 0;
         p->pid = 0;
         p->parent = 0;
         p->name[0] = 0;
         p->killed = 0;
         p->state = UNUSED;
+        procseq(p);
         release(&ptable.lock);
         return pid;
       }
@@ -563,221 +844,295 @@ wait(void)
 static void
 assertPriority(struct proc * p, int prio, const char * func, int line)
 {
-  if(p->prio == prio)
+  if(schedprio(p) == prio)
     return;
   cprintf("Error: proc priority is %d and should be %d.\nCalled from %s line %d\n",
-      p->prio, prio, func, line);
+      schedprio(p), prio, func, line);
   panic("Error: Process priority incorrect in assertPriority()");
 }
 
-/*
-   static void
-   setDefaultBudgets()
-   {
-   struct proc * p;
-
-   for(int i = MAXPRIO - 1; i >= 0; --i) {
-   for(p = ptable.ready[i].head; p != NULL; p = p->next)
-   p->budget = DEFAULT_BUDGET;
-   }
-   }
-   */
+//Promotion is lazy.  Rather than walk every process each
+//TICKS_TO_PROMOTE ticks, promote() bumps ptable.epoch, and a process's
+//effective priority is its prio raised by one for each epoch since
+//p->epoch, up to MAXPRIO.  catchup() folds that into p->prio whenever
+//a process is queued, dequeued or charged.
+//
+//Ready lists are kept in a ring so that promoting everything on them
+//is O(1) too: priority i lives in ready[(i + rot) % (MAXPRIO + 1)],
+//and a promotion rotates the ring down by one, moving each list up a
+//level, after splicing the MAXPRIO list in front of the list that
+//joins it there.
+static struct ptrs*
+readylist(uint prio)
+{
+  return &ptable.ready[(prio + ptable.rot) % (MAXPRIO + 1)];
+}
 
-static void
-promoteAllProcs(void)
+//prio as of epoch, raised a level for each promotion since.
+static uint
+lift(uint prio, uint epoch)
 {
-  for(int i = MAXPRIO; i >= 1; --i) {
-    //No processes in the next lowest priority queue to promote.
-    if(!ptable.ready[i - 1].head)
-      continue;
+  uint n = ptable.epoch - epoch;
 
-    //Increase the prio values for all the process about to be placed
-    //in a higher prio list. Set default budgets as well.
-    for(struct proc * p = ptable.ready[i - 1].head; p != NULL; p = p->next) {
-      ++(p->prio);
-      p->budget = DEFAULT_BUDGET;
-    }
+  if(prio >= MAXPRIO || n == 0)
+    return prio;
+  if(n >= MAXPRIO - prio)
+    return MAXPRIO;
+  return prio + n;
+}
 
-    //List is empty so add at head.
-    if(!ptable.ready[i].head)
-      ptable.ready[i].head = ptable.ready[i - 1].head;
+static uint
+effprio(struct proc *p)
+{
+  return lift(p->prio, p->epoch);
+}
 
-    //List is not empty, so add at the end (tail->next).
-    else
-      ptable.ready[i].tail->next = ptable.ready[i - 1].head;
+//The priority p is scheduled at: its own, or that of the most
+//important process waiting for a sleeplock it holds.  The loan
+//is promoted along with everything else so that p stays on the
+//ready list it was put on.
+static uint
+schedprio(struct proc *p)
+{
+  uint prio = effprio(p), lent;
 
-    ptable.ready[i].tail = ptable.ready[i - 1].tail;
+  if(p->inherit < 0)
+    return prio;
+  lent = lift(p->inherit, p->inhepoch);
+  return lent > prio ? lent : prio;
+}
 
-    ptable.ready[i - 1].head = NULL;
-    ptable.ready[i - 1].tail = NULL;
+static void
+catchup(struct proc *p)
+{
+  uint prio = effprio(p);
+
+  //Each promotion comes with a fresh budget.
+  if(prio != p->prio) {
+    p->prio = prio;
+    p->budget = DEFAULT_BUDGET;
+    evtrace(SEV_PROMOTE, p->pid, prio);
   }
+  p->epoch = ptable.epoch;
+}
 
-  for(int i = SLEEPING; i <= RUNNING; ++i) {
-    if(i == RUNNABLE)
-      continue;
+static void
+promote(void)
+{
+  struct ptrs *top = readylist(MAXPRIO);
+  struct ptrs *next = readylist(MAXPRIO - 1);
 
-    for(struct proc * p = ptable.list[i].head; p != NULL; p = p->next) {
-      if(p->prio != MAXPRIO)
-      {
-        ++(p->prio);
-        p->budget = DEFAULT_BUDGET;
-      }
+  if(top->head) {
+    if(next->head) {
+      top->tail->next = next->head;
+      top->tail = next->tail;
     }
+    *next = *top;
+    top->head = NULL;
+    top->tail = NULL;
   }
+  ptable.rot = (ptable.rot + MAXPRIO) % (MAXPRIO + 1);
+  ptable.epoch++;
+  evtrace(SEV_BOOST, 0, ptable.epoch);
 }
-#endif
 
-//PAGEBREAK: 42
-// Per-CPU process scheduler.
-// Each CPU calls scheduler() after setting itself up.
-// Scheduler never returns.  It loops, doing:
-//  - choose a process to run
-//  - swtch to start running that process
-//  - eventually that process transfers control
-//      via swtch back to the scheduler.
-#if defined(CS333_P4)
-void
-scheduler(void)
+// The ready list p belongs on.
+static struct ptrs*
+readyq(struct proc *p)
 {
-  struct proc *p = NULL;
-  struct cpu *c = mycpu();
-  c->proc = 0;
-#ifdef PDX_XV6
-  int idle;  // for checking if processor is idle
-#endif // PDX_XV6
-
-  for(;;){
-    // Enable interrupts on this processor.
-    sti();
-
-#ifdef PDX_XV6
-    idle = 1;  // assume idle unless we schedule a process
-#endif // PDX_XV6
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
+  if(p->tickets)
+    return &ptable.stride;
+  return readylist(schedprio(p));
+}
 
-    //Time to promote all processes.
-    if(ptable.PromoteAtTime <= ticks) {
-      //This function promotes all processes that are not on the MAXPRIO
-      //queue, increments the prio field of each process that gets
-      //promoted, and resets budgets to default.
-      promoteAllProcs();
+// Put a RUNNABLE process on its ready list.  A client that has
+// been away from the CPU rejoins at the current virtual time, so
+// it cannot bank credit while it sleeps.
+static void
+readyAdd(struct proc *p)
+{
+  catchup(p);
+  if(p->tickets) {
+    if(p->pass < ptable.vtime)
+      p->pass = ptable.vtime;
+  } else if(ptable.mlfqpass < ptable.vtime)
+    ptable.mlfqpass = ptable.vtime;
+  stateListAdd(readyq(p), p);
+  evtrace(SEV_ENQUEUE, p->pid, p->tickets ? -1 : p->prio);
+}
+#endif
 
-      //Then, reset the next time that this promotion for all processes
-      //is to occur.
-      ptable.PromoteAtTime = ticks + TICKS_TO_PROMOTE;
-    }
+// May p run on CPU c?
+static int
+runson(struct proc *p, int c)
+{
+  return (p->affinity >> c) & 1;
+}
 
-    //I will represent the prio of the queue that the process to run
-    //was found on (if one was found at all).
-    int i;
+// Only the first WARMSCAN processes that may run are looked at for
+// one whose cache may still be warm, so that a process can be
+// passed over at most a few times before it runs.
+#define WARMSCAN 4
 
-    //Try to find a process to run.
-    for(i = MAXPRIO; i >= 0; --i) {
-      p = ptable.ready[i].head;
-      if(p)
-        break;
-    }
+#ifdef CS333_P3
+// The first process on a ready list that may run on this CPU,
+// unless one of the next few last ran here and may still have a
+// warm cache.  prev, which has just had its turn, is never
+// preferred over an earlier waiter.
+static struct proc*
+pickfrom(struct proc *head, struct proc *prev)
+{
+  struct proc *p, *first = NULL;
+  int c = cpuid(), n = 0;
 
-    if(p) {
+  for(p = head; p != NULL && n < WARMSCAN; p = p->next) {
+    if(!runson(p, c))
+      continue;
+    if(p->lastcpu == c && p != prev)
+      return p;
+    if(first == NULL)
+      first = p;
+    n++;
+  }
+  return first;
+}
+#endif  //CS333_P3
 
-      // Switch to chosen process.  It is the process's job
-      // to release ptable.lock and then reacquire it
-      // before jumping back to us.
-#ifdef PDX_XV6
-      idle = 0;  // not idle this timeslice
-#endif // PDX_XV6
-      c->proc = p;
-      switchuvm(p);
-      if(stateListRemove(&ptable.ready[p->prio], p) < 0)
-        panic("Process not found when removing from state list (scheduler)");
-      assertState(p, RUNNABLE, __FUNCTION__, __LINE__);
+// Choose the next process to run on this CPU, take it off the
+// ready list, and mark it RUNNING.  prev is the process giving up
+// the CPU, or 0 when called from the scheduler.  Returns 0 if
+// nothing is runnable.  Caller must hold ptable.lock.
+#if defined(CS333_P4)
+static struct proc*
+nextproc(struct proc *prev)
+{
+  struct proc *p = NULL, *s, *q;
+  int i;
 
-      //This next line of code is to assert that it was on the correct
-      //priority queue. I is the priority queue it was pulled off of
-      //from the above for loop.
-      assertPriority(p, i, __FUNCTION__, __LINE__);
+  //Time to promote all processes.
+  if(ptable.PromoteAtTime <= ticks) {
+    //This function promotes all processes that are not on the MAXPRIO
+    //queue.  Their prio fields and budgets catch up lazily.
+    promote();
 
-      p->state = RUNNING;
-      stateListAdd(&ptable.list[p->state], p);
-#ifdef CS333_P2
-      p->cpu_ticks_in = ticks;
-#endif  //CS333_P2
-      swtch(&(c->scheduler), p->context);
-      switchkvm();
+    //Then, reset the next time that this promotion for all processes
+    //is to occur.
+    ptable.PromoteAtTime = ticks + TICKS_TO_PROMOTE;
+  }
 
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
-    }
-    release(&ptable.lock);
-#ifdef PDX_XV6
-    // if idle, wait for next interrupt
-    if (idle) {
-      sti();
-      hlt();
-    }
-#endif // PDX_XV6
+  //I will represent the prio of the queue that the process to run
+  //was found on (if one was found at all).
+  for(i = MAXPRIO; i >= 0; --i) {
+    p = pickfrom(readylist(i)->head, prev);
+    if(p)
+      break;
   }
+
+  //The MLFQ class competes with each stride process as one client
+  //holding MLFQ_TICKETS.  Whichever has the lowest pass runs.
+  s = NULL;
+  for(q = ptable.stride.head; q != NULL; q = q->next)
+    if(runson(q, cpuid()) && (s == NULL || q->pass < s->pass))
+      s = q;
+
+  if(s && (p == NULL || s->pass < ptable.mlfqpass)) {
+    p = s;
+    ptable.vtime = p->pass;
+    if(stateListRemove(&ptable.stride, p) < 0)
+      panic("Process not found when removing from state list (nextproc)");
+    assertState(p, RUNNABLE, __FUNCTION__, __LINE__);
+  } else if(p) {
+    ptable.vtime = ptable.mlfqpass;
+    if(stateListRemove(readylist(i), p) < 0)
+      panic("Process not found when removing from state list (nextproc)");
+    assertState(p, RUNNABLE, __FUNCTION__, __LINE__);
+    catchup(p);
+
+    //This next line of code is to assert that it was on the correct
+    //priority queue. I is the priority queue it was pulled off of
+    //from the above for loop.
+    assertPriority(p, i, __FUNCTION__, __LINE__);
+  } else
+    return NULL;
+
+  p->state = RUNNING;
+  stateListAdd(&ptable.list[p->state], p);
+  p->cpu_cycles_in = rdtsc();
+  p->lastcpu = cpuid();
+  evtrace(SEV_DEQUEUE, p->pid, p->tickets ? -1 : p->prio);
+  return p;
 }
 
 #elif defined(CS333_P3)
-void
-scheduler(void)
+static struct proc*
+nextproc(struct proc *prev)
 {
   struct proc *p;
-  struct cpu *c = mycpu();
-  c->proc = 0;
-#ifdef PDX_XV6
-  int idle;  // for checking if processor is idle
-#endif // PDX_XV6
-
-  for(;;){
-    // Enable interrupts on this processor.
-    sti();
-
-#ifdef PDX_XV6
-    idle = 1;  // assume idle unless we schedule a process
-#endif // PDX_XV6
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    p = ptable.list[RUNNABLE].head;
-    if(p) {
 
-      // Switch to chosen process.  It is the process's job
-      // to release ptable.lock and then reacquire it
-      // before jumping back to us.
-#ifdef PDX_XV6
-      idle = 0;  // not idle this timeslice
-#endif // PDX_XV6
-      c->proc = p;
-      switchuvm(p);
-      if(stateListRemove(&ptable.list[p->state], p) < 0)
-        panic("Process not found when removing from state list");
-      assertState(p, RUNNABLE, __FUNCTION__, __LINE__);
-      p->state = RUNNING;
-      stateListAdd(&ptable.list[p->state], p);
-#ifdef CS333_P2
-      p->cpu_ticks_in = ticks;
-#endif  //CS333_P2
-      swtch(&(c->scheduler), p->context);
-      switchkvm();
+  p = pickfrom(ptable.list[RUNNABLE].head, prev);
+  if(p == NULL)
+    return NULL;
+  if(stateListRemove(&ptable.list[p->state], p) < 0)
+    panic("Process not found when removing from state list");
+  assertState(p, RUNNABLE, __FUNCTION__, __LINE__);
+  p->state = RUNNING;
+  stateListAdd(&ptable.list[p->state], p);
+  p->cpu_cycles_in = rdtsc();
+  p->lastcpu = cpuid();
+  evtrace(SEV_DEQUEUE, p->pid, 0);
+  return p;
+}
 
-      // Process is done running for now.
-      // It should have changed its p->state before coming back.
-      c->proc = 0;
-    }
-    release(&ptable.lock);
-#ifdef PDX_XV6
-    // if idle, wait for next interrupt
-    if (idle) {
-      sti();
-      hlt();
+#else
+// Scan round-robin from the process after prev for the first
+// process that may run here, unless one of the next few last ran
+// on this CPU.  prev itself comes last and is never preferred.
+static struct proc*
+nextproc(struct proc *prev)
+{
+  struct proc *p, *first, *start;
+  int c, n;
+
+  c = cpuid();
+  first = 0;
+  n = 0;
+  start = prev && prev->anext ? prev->anext : ptable.all;
+  for(p = start; p && n < WARMSCAN; ){
+    if(p->state == RUNNABLE && runson(p, c)){
+      if(p->lastcpu == c && p != prev)
+        break;
+      if(first == 0)
+        first = p;
+      n++;
     }
-#endif // PDX_XV6
+    p = p->anext ? p->anext : ptable.all;
+    if(p == start)
+      p = 0;
   }
+  if(p == 0 || n == WARMSCAN)
+    p = first;
+  if(p == 0)
+    return 0;
+  p->state = RUNNING;
+#ifdef CS333_P2
+  p->cpu_cycles_in = rdtsc();
+#endif  //CS333_P2
+  p->lastcpu = c;
+  evtrace(SEV_DEQUEUE, p->pid, 0);
+  return p;
 }
-#else
+#endif
+
+// Per-CPU process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - choose a process to run
+//  - swtch to start running that process
+//  - eventually that process transfers control
+//      via swtch back to the scheduler.
+// Processes that give up the CPU switch straight to the next
+// runnable process (see sched), so the scheduler only gets the
+// CPU back when there is nothing else to run.
 void
 scheduler(void)
 {
@@ -786,6 +1141,7 @@ scheduler(void)
   c->proc = 0;
 #ifdef PDX_XV6
   int idle;  // for checking if processor is idle
+  uint64 idlesince = 0;  // TSC when the last pass found nothing
 #endif // PDX_XV6
 
   for(;;){
@@ -797,9 +1153,13 @@ scheduler(void)
 #endif // PDX_XV6
     // Loop over process table looking for process to run.
     acquire(&ptable.lock);
-    for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-      if(p->state != RUNNABLE)
-        continue;
+#ifdef PDX_XV6
+    if(idlesince)
+      c->idle += rdtsc() - idlesince;
+    idlesince = 0;
+#endif // PDX_XV6
+    p = nextproc(0);
+    if(p) {
 
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
@@ -809,10 +1169,8 @@ scheduler(void)
 #endif // PDX_XV6
       c->proc = p;
       switchuvm(p);
-      p->state = RUNNING;
-#ifdef CS333_P2
-      p->cpu_ticks_in = ticks;
-#endif  //CS333_P2
+      c->nswitch++;
+      evtrace(SEV_SWITCH, 0, p->pid);
       swtch(&(c->scheduler), p->context);
       switchkvm();
 
@@ -820,17 +1178,22 @@ scheduler(void)
       // It should have changed its p->state before coming back.
       c->proc = 0;
     }
+#ifdef PDX_XV6
+    if(idle)
+      idlesince = rdtsc();
+#endif // PDX_XV6
     release(&ptable.lock);
 #ifdef PDX_XV6
-    // if idle, wait for next interrupt
+    // if idle, zero a free page for kzalloc(), or if there is
+    // none to do, wait for next interrupt
     if (idle) {
       sti();
-      hlt();
+      if(!kzerofill())
+        hlt();
     }
 #endif // PDX_XV6
   }
 }
-#endif
 
 // Enter scheduler.  Must hold only ptable.lock
 // and have changed proc->state. Saves and restores
@@ -839,11 +1202,17 @@ scheduler(void)
 // be proc->intena and proc->ncli, but that would
 // break in the few places where a lock is held but
 // there's no process.
+// If another process is runnable, switch to it directly
+// rather than through the scheduler, saving a context
+// switch and a page table load; the scheduler only runs
+// when the CPU is about to go idle.
 void
 sched(void)
 {
   int intena;
   struct proc *p = myproc();
+  struct proc *np;
+  struct cpu *c = mycpu();
 
   if(!holding(&ptable.lock))
     panic("sched ptable.lock");
@@ -856,12 +1225,54 @@ sched(void)
   intena = mycpu()->intena;
 
 #ifdef CS333_P2
-  p->cpu_ticks_total += ticks - p->cpu_ticks_in;
+  procseq(p);
+  p->cpu_cycles_total += rdtsc() - p->cpu_cycles_in;
+  procseq(p);
 #endif  //CS333_P2
 
-  swtch(&p->context, mycpu()->scheduler);
-  mycpu()->intena = intena;
+  np = nextproc(p);
+  if(np == p)  // a yield with nothing better to run
+    return;
+  evtrace(SEV_SWITCH, p->pid, np ? np->pid : 0);
+  if(np){
+    // np releases ptable.lock, in sched() or forkret().
+    c->proc = np;
+    c->nswitch++;
+    switchuvm(np);
+    swtch(&p->context, np->context);
+  } else
+    swtch(&p->context, c->scheduler);
+  mycpu()->intena = intena;
+}
+
+#ifdef CS333_P4
+// Charge p for the CPU time since it was scheduled, measured
+// with the TSC so that short runs between ticks are not free.
+// A stride process advances its pass.  An MLFQ process advances
+// the pass of the MLFQ class and drops a priority level once its
+// budget is used up.
+static void
+charge(struct proc *p)
+{
+  uint us;
+
+  catchup(p);
+  us = tscus(rdtsc() - p->cpu_cycles_in);
+  if(p->tickets) {
+    p->pass += (uint64)p->stride * us;
+    return;
+  }
+  ptable.mlfqpass += (uint64)(STRIDE1 / MLFQ_TICKETS) * us;
+  p->budget -= us;
+  if(p->budget <= 0) {
+    if(p->prio > 0) {
+      --(p->prio);
+      evtrace(SEV_DEMOTE, p->pid, p->prio);
+    }
+    p->budget = DEFAULT_BUDGET;
+  }
 }
+#endif  //CS333_P4
 
 // Give up the CPU for one scheduling round.
 #ifdef CS333_P3
@@ -876,15 +1287,8 @@ yield(void)
   assertState(curproc, RUNNING, __FUNCTION__, __LINE__);
   curproc->state = RUNNABLE;
 #ifdef CS333_P4
-  curproc->budget -= ticks - curproc->cpu_ticks_in;
-  if(curproc->budget <= 0) {
-    if(curproc->prio > 0)
-    {
-      --(curproc->prio);
-    }
-    curproc->budget = DEFAULT_BUDGET;
-  }
-  stateListAdd(&ptable.ready[curproc->prio], curproc);
+  charge(curproc);
+  readyAdd(curproc);
 #else
   stateListAdd(&ptable.list[curproc->state], curproc);
 #endif
@@ -912,7 +1316,7 @@ void
 forkret(void)
 {
   static int first = 1;
-  // Still holding ptable.lock from scheduler.
+  // Still holding ptable.lock from scheduler() or sched().
   release(&ptable.lock);
 
   if (first) {
@@ -922,6 +1326,7 @@ forkret(void)
     first = 0;
     iinit(ROOTDEV);
     initlog(ROOTDEV);
+    swapinit(ROOTDEV);
   }
 
   // Return to "caller", actually trapret (see allocproc).
@@ -950,6 +1355,7 @@ sleep(void *chan, struct spinlock *lk)
   }
   // Go to sleep.
   p->chan = chan;
+  evtrace(SEV_SLEEP, p->pid, 0);
 
   if(stateListRemove(&ptable.list[p->state], p) < 0)
     panic("Process not found when removing from state list (sleep)");
@@ -958,12 +1364,7 @@ sleep(void *chan, struct spinlock *lk)
   stateListAdd(&ptable.list[p->state], p);
 
 #ifdef CS333_P4
-  p->budget -= ticks - p->cpu_ticks_in;
-  if(p->budget <= 0) {
-    if(p->prio > 0)
-      --(p->prio);
-    p->budget = DEFAULT_BUDGET;
-  }
+  charge(p);
 #endif
 
   sched();
@@ -998,6 +1399,7 @@ sleep(void *chan, struct spinlock *lk)
   }
   // Go to sleep.
   p->chan = chan;
+  evtrace(SEV_SLEEP, p->pid, 0);
   p->state = SLEEPING;
 
   sched();
@@ -1020,23 +1422,23 @@ sleep(void *chan, struct spinlock *lk)
 static void
 wakeup1(void *chan)
 {
-  struct proc *p;
+  struct proc *p, *next;
 
-  for(p = ptable.list[SLEEPING].head; p && p != ptable.list[SLEEPING].tail->next; p = p->next) {
+  // Moving p to a ready list rewrites p->next, so fetch it first.
+  for(p = ptable.list[SLEEPING].head; p != NULL; p = next) {
+    next = p->next;
     if(p->chan == chan) {
       if(stateListRemove(&ptable.list[p->state], p) < 0)
         panic("Process not found when removing from state list (wakeup1)");
       assertState(p, SLEEPING, __FUNCTION__, __LINE__);
       p->state = RUNNABLE;
+      evtrace(SEV_WAKEUP, p->pid, 0);
 #ifdef CS333_P4
-      stateListAdd(&ptable.ready[p->prio], p);
+      readyAdd(p);
 #else
       stateListAdd(&ptable.list[p->state], p);
 #endif
     }
-
-    if(p == ptable.list[SLEEPING].tail)
-      break;
   }
 }
 #else
@@ -1045,9 +1447,11 @@ wakeup1(void *chan)
 {
   struct proc *p;
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if(p->state == SLEEPING && p->chan == chan)
+  for(p = ptable.all; p; p = p->anext)
+    if(p->state == SLEEPING && p->chan == chan){
       p->state = RUNNABLE;
+      evtrace(SEV_WAKEUP, p->pid, 0);
+    }
 }
 #endif
 
@@ -1063,107 +1467,172 @@ wakeup(void *chan)
 // Kill the process with the given pid.
 // Process won't exit until it returns
 // to user space (see trap in trap.c).
-#if defined(CS333_P4)
 int
 kill(int pid)
 {
   struct proc *p;
 
   acquire(&ptable.lock);
+  if((p = findproc(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  p->killed = 1;
+  // Wake process from sleep if necessary.
+  if(p->state == SLEEPING){
+#ifdef CS333_P3
+    if(stateListRemove(&ptable.list[p->state], p) < 0)
+      panic("Process not found when removing from state list (kill)");
+    assertState(p, SLEEPING, __FUNCTION__, __LINE__);
+    p->state = RUNNABLE;
+#ifdef CS333_P4
+    p->prio = MAXPRIO;
+    p->budget = DEFAULT_BUDGET;
+    readyAdd(p);
+#else
+    stateListAdd(&ptable.list[p->state], p);
+#endif
+#else
+    p->state = RUNNABLE;
+#endif  //CS333_P3
+  }
+  release(&ptable.lock);
+  return 0;
+}
 
-  for(int i = EMBRYO; i <= RUNNING; ++i) {
-    if(i == RUNNABLE)
-      break;
-    for(p = ptable.list[i].head; p != NULL; p = p->next) {
-      if(p->pid == pid){
-        p->killed = 1;
-        // Wake process from sleep if necessary.
-        if(p->state == SLEEPING) {
-          if(stateListRemove(&ptable.list[p->state], p) < 0)
-            panic("Process not found when removing from state list (kill)");
-          assertState(p, SLEEPING, __FUNCTION__, __LINE__);
-          p->state = RUNNABLE;
-          p->prio = MAXPRIO;
-          p->budget = DEFAULT_BUDGET;
-          stateListAdd(&ptable.ready[p->prio], p);
-        }
-        release(&ptable.lock);
-        return 0;
-      }
-    }
+// Restrict the process with the given pid to the CPUs in mask,
+// bit i standing for CPU i.  It moves at its next reschedule.
+int
+setaffinity(int pid, uint mask)
+{
+  struct proc *p;
 
-    if(p == ptable.list[i].tail)
-      break;
-  }
+  if(ncpu < 32)
+    mask &= (1 << ncpu) - 1;
+  if(mask == 0)
+    return -1;
 
-  for(int j = MAXPRIO; j >= 0; --j) {
-    for(p = ptable.ready[j].head; p != NULL; p = p->next) {
-      if(p->pid == pid){
-        p->killed = 1;
-        release(&ptable.lock);
-        return 0;
-      }
-    }
+  acquire(&ptable.lock);
+  if((p = findproc(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
   }
-
+  p->affinity = mask;
   release(&ptable.lock);
-  return -1;
+  return 0;
 }
 
-#elif defined(CS333_P3)
+// The CPUs the process with the given pid may run on, or -1.
 int
-kill(int pid)
+getaffinity(int pid)
 {
   struct proc *p;
+  int mask;
 
   acquire(&ptable.lock);
+  if((p = findproc(pid)) == 0){
+    release(&ptable.lock);
+    return -1;
+  }
+  mask = p->affinity;
+  release(&ptable.lock);
+  if(ncpu < 32)
+    mask &= (1 << ncpu) - 1;
+  return mask;
+}
 
-  for(int i = EMBRYO; i <= RUNNING; ++i) {
-    for(p = ptable.list[i].head; p != NULL; p = p->next) {
-      if(p->pid == pid){
-        p->killed = 1;
-        // Wake process from sleep if necessary.
-        if(p->state == SLEEPING) {
-          if(stateListRemove(&ptable.list[p->state], p) < 0)
-            panic("Process not found when removing from state list (kill)");
-          assertState(p, SLEEPING, __FUNCTION__, __LINE__);
-          p->state = RUNNABLE;
-          stateListAdd(&ptable.list[p->state], p);
-        }
-        release(&ptable.lock);
-        return 0;
-      }
-    }
+// Copy the memory event counts of the process with the given pid
+// into v, or the system-wide totals if pid is 0.  Returns -1 if
+// there is no such process.
+int
+getvmstat(int pid, struct vmstat *v)
+{
+  struct proc *p;
+  int i, ev;
 
-    if(p == ptable.list[i].tail)
-      break;
+  memset(v, 0, sizeof(*v));
+  acquire(&ptable.lock);
+  if(pid == 0){
+    for(i = 0; i < ncpu; i++)
+      for(ev = 0; ev < NVMSTAT; ev++)
+        v->ev[ev] += cpus[i].vmev[ev];
+  } else if((p = findproc(pid)) != 0){
+    memmove(v->ev, p->vmev, sizeof(v->ev));
+  } else {
+    release(&ptable.lock);
+    return -1;
   }
+  release(&ptable.lock);
+  return 0;
+}
 
+// 1, 5 and 15 minute load averages, see cpustat.h.
+static uint loadavg[3];
+
+// Processes running or waiting to run.  Caller holds ptable.lock.
+static uint
+nrunning(void)
+{
+  struct proc *p;
+  uint n = 0;
+
+  for(p = ptable.all; p; p = p->anext)
+    if(p->state == RUNNABLE || p->state == RUNNING)
+      n++;
+  return n;
+}
+
+// Fold the number of running and runnable processes into the
+// load averages every LOADFREQ seconds.  Called by CPU 0 on
+// each clock tick.
+void
+calcload(void)
+{
+  static uint exps[3] = { EXP_1, EXP_5, EXP_15 };
+  uint n;
+  int i;
+
+  if(ticks % (LOADFREQ * TPS) != 0)
+    return;
+  acquire(&ptable.lock);
+  n = nrunning();
+  for(i = 0; i < 3; i++)
+    loadavg[i] = (loadavg[i] * exps[i] +
+                  n * FIXED_1 * (FIXED_1 - exps[i])) >> FSHIFT;
   release(&ptable.lock);
-  return -1;
 }
 
-#else
-int
-kill(int pid)
+// Snapshot the per-CPU counters and load averages.  The idle
+// time and the running process of a CPU change only under
+// ptable.lock, so the copy is consistent.
+void
+getcpustats(struct sysload *s)
 {
   struct proc *p;
+  struct cpustat *cs;
+  int i;
 
+  memset(s, 0, sizeof(*s));
   acquire(&ptable.lock);
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->pid == pid){
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if(p->state == SLEEPING)
-        p->state = RUNNABLE;
-      release(&ptable.lock);
-      return 0;
-    }
+  s->tsc = rdtsc();
+  for(i = 0; i < 3; i++)
+    s->load[i] = loadavg[i];
+  s->nrun = nrunning();
+  s->ncpu = ncpu;
+  for(i = 0; i < ncpu; i++){
+    cs = &s->cpu[i];
+    cs->idle = cpus[i].idle;
+    cs->nswitch = cpus[i].nswitch;
+    cs->nintr = cpus[i].nintr;
+    cs->pid = cpus[i].proc ? cpus[i].proc->pid : 0;
   }
+  for(p = ptable.all; p; p = p->anext)
+    if(p->state == RUNNABLE)
+      for(i = 0; i < ncpu; i++)
+        if(runson(p, i))
+          s->cpu[i].nready++;
   release(&ptable.lock);
-  return -1;
 }
-#endif
 
 //PAGEBREAK: 36
 // Print a process listing to console.  For debugging.
@@ -1201,16 +1670,15 @@ procdumpP2(struct proc * p, char * state)
     cprintf("%d\t", p->parent->pid);
 
 #ifdef CS333_P4
-  cprintf("%d\t", p->prio);
+  cprintf("%d\t", schedprio(p));
 #endif
 
   procdumpP1(p, state);
 
-  //cprintf("%d\t", p->cpu_ticks_total);
   int num_ticks_per_second = 1000;
 
-  //Calculate the time ellapsed in ticks (sec and millisec).
-  int time_elapsed = p->cpu_ticks_total;
+  //Calculate the CPU time in milliseconds (sec and millisec).
+  int time_elapsed = tscus(p->cpu_cycles_total) / 1000;
   int tick_seconds = time_elapsed/num_ticks_per_second;
   int tick_milliseconds = time_elapsed % num_ticks_per_second;
 
@@ -1254,10 +1722,7 @@ procdump(void)
 
   cprintf(HEADER);  // not conditionally compiled as must work in all project states
 
-  for(p = ptable.proc; p < &ptable.proc[NPROC]; p++){
-    if(p->state == UNUSED)  {
-      continue;
-    }
+  for(p = ptable.all; p; p = p->anext){
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
       state = states[p->state];
     else
@@ -1349,6 +1814,7 @@ set_uid(uint uid)
 {
   acquire(&ptable.lock);
   myproc()->uid = uid;
+  vdsosetproc(myproc());
   release(&ptable.lock);
 
   return 0;
@@ -1359,51 +1825,100 @@ set_gid(uint gid)
 {
   acquire(&ptable.lock);
   myproc()->gid = gid;
+  vdsosetproc(myproc());
   release(&ptable.lock);
 
   return 0;
 }
 
 
-int
-get_procs(int max, struct uproc *table)
+// Copy what ps reports about p into u, without ptable.lock.
+// Every field is read in a single load, but the process could
+// exit and its slot be reused part way through, so the copy is
+// retried until p->seq shows it is all of one process.  Returns
+// 0 if the slot is unused or p does not match q.
+static int
+snapproc(struct proc *p, struct procquery *q, struct uproc *u)
 {
-  char *state;
-  int count = 0;
+  enum procstate state;
+  struct proc *pp;
+  uint seq;
+  uint64 cycles;
 
-  acquire(&ptable.lock);
-  for(struct proc *p = ptable.proc; count < max && p < &ptable.proc[NPROC]; p++){
-    if(p->state == UNUSED || p->state == EMBRYO)  {
+  for(;;){
+    seq = p->seq;
+    if(seq & 1)
       continue;
-    }
-    if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
-      state = states[p->state];
-    else
-      state = "???";
+    __sync_synchronize();
+    state = p->state;
+    if(state == UNUSED || state == EMBRYO)
+      return 0;
 
-    //copy over all the data
-    table[count].pid = p->pid;
-    table[count].uid = p->uid;
-    table[count].gid = p->gid;
-    if(!p->parent)
-      table[count].ppid = p->pid;
-    else
-      table[count].ppid = p->parent->pid;
+    u->pid = p->pid;
+    u->uid = p->uid;
+    u->gid = p->gid;
+    pp = p->parent;
+    u->ppid = pp ? pp->pid : p->pid;
 #ifdef CS333_P4
-    table[count].priority = p->prio;
+    u->priority = schedprio(p);
 #endif
-    table[count].elapsed_ticks = ticks - p->start_ticks;
-    table[count].CPU_total_ticks= p->cpu_ticks_total;
-    strncpy(table[count].state, state, (strlen(state) + 1));
-    table[count].size = p->sz;
-    strncpy(table[count].name, p->name, (strlen(state) + 1));
-
-    ++count;
+    u->elapsed_ticks = ticks - p->start_ticks;
+    cycles = p->cpu_cycles_total;
+    u->size = p->sz;
+    u->rss = p->rss * PGSIZE;
+    u->ptpages = p->ptpages;
+    u->kmem = KSTACKSIZE + PGSIZE + p->ptpages * PGSIZE;  // + vdso page
+    u->affinity = p->affinity;
+    safestrcpy(u->name, p->name, sizeof(p->name));
+
+    __sync_synchronize();
+    if(p->seq == seq)
+      break;
   }
 
-  release(&ptable.lock);
+  if(q->states && !(q->states & (1 << state)))
+    return 0;
+  if(q->uid >= 0 && u->uid != (uint)q->uid)
+    return 0;
+  if(u->pid < q->minpid || (q->maxpid && u->pid > q->maxpid))
+    return 0;
+
+  u->CPU_total_us = tscus(cycles);
+  u->CPU_total_ticks = u->CPU_total_us / (1000000 / TPS);
+  safestrcpy(u->state, states[state], STRMAX);
+  if(ncpu < 32)
+    u->affinity &= (1 << ncpu) - 1;
+  return 1;
+}
+
+// Copy up to max processes that match q into table, starting
+// at slot q->start, and advance q->start past the last slot
+// looked at so that the next call carries on from there.
+// Returns the number copied; fewer than max means the scan is
+// done.  Monitors can poll this as often as they like, since
+// it never takes ptable.lock.
+int
+procquery(struct procquery *q, struct uproc *table, int max)
+{
+  int count = 0;
+
+  if(max < 0)
+    return -1;
+  while(count < max && q->start < ptable.nslot){
+    if(snapproc(ptable.slot[q->start], q, &table[count]))
+      count++;
+    q->start++;
+  }
   return count;
 }
+
+int
+get_procs(int max, struct uproc *table)
+{
+  struct procquery q = { 0, 0, -1, 0, 0 };
+
+  return procquery(&q, table, max);
+}
 #endif  //CS333_P2
 
 
@@ -1483,20 +1998,11 @@ initProcessLists()
     ptable.ready[i].head = NULL;
     ptable.ready[i].tail = NULL;
   }
+  ptable.stride.head = NULL;
+  ptable.stride.tail = NULL;
 #endif
 }
 
-static void
-initFreeList(void)
-{
-  struct proc* p;
-
-  for(p = ptable.proc; p < ptable.proc + NPROC; ++p){
-    p->state = UNUSED;
-    stateListAdd(&ptable.list[UNUSED], p);
-  }
-}
-
 static void
 assertState(struct proc *p, enum procstate state, const char * func, int line)
 {
@@ -1539,10 +2045,10 @@ proc_ready(void)
 
     cprintf("Priority %d: ", i);
 
-    for(p = ptable.ready[i].head; p != NULL; p = p->next) {
+    for(p = readylist(i)->head; p != NULL; p = p->next) {
       cprintf("(%d, %d)", p->pid, p->budget);
 
-      if(p == ptable.ready[i].tail)
+      if(p == readylist(i)->tail)
         break;
       else
         cprintf(" -> ");
@@ -1551,6 +2057,14 @@ proc_ready(void)
     cprintf("\n");
   }
 
+  cprintf("Stride: ");
+  for(p = ptable.stride.head; p != NULL; p = p->next) {
+    cprintf("(%d, %d)", p->pid, p->tickets);
+    if(p != ptable.stride.tail)
+      cprintf(" -> ");
+  }
+  cprintf("\n");
+
   release(&ptable.lock);
 
   cprintf("\n$ ");
@@ -1638,19 +2152,6 @@ proc_zombie(void)
 #endif
 
 #ifdef CS333_P4
-static struct proc *
-retrieveFromList(struct proc * head, int pid)
-{
-  while(head)
-  {
-    if(head->pid == pid)
-      break;
-    head = head->next;
-  }
-
-  return head;
-}
-
 //Helper function for the getpriority system call.
 int
 get_priority(int pid)
@@ -1661,103 +2162,210 @@ get_priority(int pid)
   struct proc * p = NULL;
 
   acquire(&ptable.lock);
+  p = findproc(pid);
 
-  //Check first to see if the process is in one of the ready lists.
-  for(int i = MAXPRIO; i >= 0; --i)
+  //There is no active process with the pid passed in.
+  if(!p || p->state == EMBRYO || p->state == ZOMBIE)
   {
-    p = retrieveFromList(ptable.ready[i].head, pid);
-    if(p)
+    release(&ptable.lock);
+    return -1;
+  }
+
+  int toReturn = effprio(p);
+  release(&ptable.lock);
+  return toReturn;
+}
+
+//The current process is about to sleep until lk is free.  Lend
+//its priority to the holder so that a less important holder
+//cannot be starved by processes in between, and on down the
+//chain if the holder is itself waiting for a sleeplock.  Caller
+//holds lk->lk.  Each lock further down is locked in turn, hand
+//over hand, before its holder is read: while a lock's lk is held
+//its holder cannot change, nor can a process waiting for it stop
+//waiting.  Two walks could only lock in opposite orders if the
+//sleeplocks themselves were deadlocked.
+void
+priolend(struct sleeplock *lk)
+{
+  struct proc *p = myproc(), *h;
+  struct sleeplock *first = lk, *next;
+  uint prio;
+  int depth;
+
+  acquire(&ptable.lock);
+  p->waitlock = lk;
+  prio = schedprio(p);
+  release(&ptable.lock);
+  h = p;
+  for(depth = 0; depth < ptable.nslot; depth++) {
+    if(h->waitlock != lk || (h = lk->holder) == NULL)
+      break;
+    acquire(&ptable.lock);
+    if(p->tickets || h->tickets || schedprio(h) >= prio) {
+      release(&ptable.lock);
       break;
+    }
+    if(h->state == RUNNABLE && stateListRemove(readyq(h), h) < 0)
+      panic("Process not found when removing from state list (priolend)");
+    h->inherit = prio;
+    h->inhepoch = ptable.epoch;
+    if(h->state == RUNNABLE)
+      stateListAdd(readyq(h), h);
+    next = h->waitlock;
+    release(&ptable.lock);
+    if(next == 0 || next == first || next == lk)
+      break;
+    acquire(&next->lk);
+    if(lk != first)
+      release(&lk->lk);
+    lk = next;
   }
+  if(lk != first)
+    release(&lk->lk);
+}
 
-  if(!p)
-  {
-    //Check to see if it is in the running list.
-    for(int i = SLEEPING; i <= RUNNING; ++i)
-    {
-      //Already checked the ready/runnable lists.
-      if(i == RUNNABLE)
-        continue;
-      p = retrieveFromList(ptable.list[i].head, pid);
-      if(p)
-        break;
+//The current process has just taken or given up a sleeplock.
+//Recompute what it inherits from the processes waiting for the
+//sleeplocks it still holds.  It is running, so it is on no
+//ready list.
+void
+prioreturn(void)
+{
+  struct proc *p = myproc(), *q;
+  uint prio;
+
+  acquire(&ptable.lock);
+  p->waitlock = 0;
+  p->inherit = -1;
+  for(q = ptable.all; q; q = q->anext) {
+    if(q->waitlock == 0 || q->waitlock->holder != p || q->tickets)
+      continue;
+    prio = schedprio(q);
+    if(p->inherit < 0 || prio > lift(p->inherit, p->inhepoch)) {
+      p->inherit = prio;
+      p->inhepoch = ptable.epoch;
     }
   }
+  release(&ptable.lock);
+}
 
-  //After going through all the lists, there was not an active process
-  //found with the pid passed in.
-  if(!p)
-  {
+//Helper function for the settickets system call.  Moves a process
+//into the stride class with the given number of tickets, or back
+//to MLFQ if tickets is 0.
+int
+set_tickets(int pid, int tickets)
+{
+  struct proc *p;
+
+  if(tickets < 0 || tickets > MAXTICKETS)
+    return -1;
+
+  acquire(&ptable.lock);
+  p = findproc(pid);
+  if(p == NULL || p->state == EMBRYO || p->state == ZOMBIE) {
     release(&ptable.lock);
     return -1;
   }
-
-  int toReturn = p->prio;
+  if(p->state == RUNNABLE && stateListRemove(readyq(p), p) < 0)
+    panic("Process not found when removing from state list (set_tickets)");
+  p->tickets = tickets;
+  if(tickets) {
+    p->stride = STRIDE1 / tickets;
+    p->pass = ptable.vtime;
+  } else
+    p->budget = DEFAULT_BUDGET;
+  if(p->state == RUNNABLE)
+    readyAdd(p);
   release(&ptable.lock);
-  return toReturn;
+  return 0;
+}
+
+//Give p priority prio.  Returns -1 if p is not a live process.
+//Caller holds ptable.lock.
+static int
+prioset(struct proc *p, int prio)
+{
+  if(!p || p->state == EMBRYO || p->state == ZOMBIE)
+    return -1;
+
+  //A runnable MLFQ process moves to the ready list for its new
+  //priority.  A runnable stride process keeps its place; the new
+  //priority applies if it goes back to MLFQ.
+  if(p->state == RUNNABLE && !p->tickets) {
+    if(effprio(p) == prio)
+      return 0;
+    if(stateListRemove(readyq(p), p) < 0)
+      panic("Process not found when removing from state list (set_priority)");
+    assertState(p, RUNNABLE, __FUNCTION__, __LINE__);
+    catchup(p);
+    p->prio = prio;
+    p->budget = DEFAULT_BUDGET;
+    stateListAdd(readyq(p), p);
+    return 0;
+  }
+
+  catchup(p);
+  if(p->prio != prio) {
+    p->prio = prio;
+    p->budget = DEFAULT_BUDGET;
+  }
+  return 0;
 }
 
 //Helper function for the setpriority system call.
 int
 set_priority(int pid, int prio)
 {
+  int rc;
+
   //Test a valid pid value passes in against the min and max values.
   //Also, test to make sure the priority value passed in is valid as well.
   if(pid < 0 || pid > 32767 || prio < 0 || prio > MAXPRIO)
     return -1;
 
-  struct proc * p = NULL;
+  acquire(&ptable.lock);
+  rc = prioset(findproc(pid), prio);
+  release(&ptable.lock);
+  return rc;
+}
+
+//Helper function for the setprioritylist system call: give each
+//of the n processes in pids priority prio, all under one hold of
+//ptable.lock.  Returns how many of them were live processes.
+int
+set_priority_list(int *pids, int n, int prio)
+{
+  int i, count = 0;
+
+  if(n < 0 || prio < 0 || prio > MAXPRIO)
+    return -1;
 
   acquire(&ptable.lock);
+  for(i = 0; i < n; i++)
+    if(prioset(findproc(pids[i]), prio) == 0)
+      count++;
+  release(&ptable.lock);
+  return count;
+}
 
-  //Check first to see if the process is in one of the ready lists.
-  for(int i = MAXPRIO; i >= 0; --i)
-  {
-    p = retrieveFromList(ptable.ready[i].head, pid);
-    if(p) {
-      if(p->prio == prio) {
-        release(&ptable.lock);
-        return 0;
-      }
-      if(stateListRemove(&ptable.ready[p->prio], p) < 0)
-        panic("Process not found when removing from state list (scheduler)");
-      assertState(p, RUNNABLE, __FUNCTION__, __LINE__);
-      
-      //This next line of code is to assert that it was on the correct
-      //priority queue. I is the priority queue it was pulled off of
-      //from the above for loop.
-      assertPriority(p, i, __FUNCTION__, __LINE__);
-
-      p->prio = prio;
-      p->budget = DEFAULT_BUDGET;
-      stateListAdd(&ptable.ready[p->prio], p);
-      release(&ptable.lock);
-      return 0;
-    }
-  }
+//Helper function for the setprioritygroup system call: give every
+//process with group id gid priority prio.  Returns how many there
+//were.
+int
+set_priority_group(uint gid, int prio)
+{
+  struct proc *p;
+  int count = 0;
 
-  //Check to see if it is in the running list.
-  for(int i = SLEEPING; i <= RUNNING; ++i)
-  {
-    //Already checked the ready/runnable lists.
-    if(i == RUNNABLE)
-      continue;
-    p = retrieveFromList(ptable.list[i].head, pid);
-    if(p) {
-      if(p->prio == prio) {
-        release(&ptable.lock);
-        return 0;
-      }
-      p->prio = prio;
-      p->budget = DEFAULT_BUDGET;
-      release(&ptable.lock);
-      return 0;
-    }
-  }
+  if(prio < 0 || prio > MAXPRIO)
+    return -1;
 
-  //After going through all the lists, there was not an active process
-  //found with the pid passed in.
+  acquire(&ptable.lock);
+  for(p = ptable.all; p; p = p->anext)
+    if(p->gid == gid && prioset(p, prio) == 0)
+      count++;
   release(&ptable.lock);
-  return -1;
+  return count;
 }
 #endif
@@ -1,13 +1,22 @@
+#include "rlimit.h"
+#include "vmstat.h"
+
 // Per-CPU state
 struct cpu {
   uchar apicid;                // Local APIC ID
   struct context *scheduler;   // swtch() here to enter scheduler
   struct taskstate ts;         // Used by x86 to find stack for interrupt
+  struct taskstate dfts;       // Task that double faults switch to
+  char *intrstack;             // Bottom of stack for device interrupts
   struct segdesc gdt[NSEGS];   // x86 global descriptor table
   volatile uint started;       // Has the CPU started?
   int ncli;                    // Depth of pushcli nesting.
   int intena;                  // Were interrupts enabled before pushcli?
   struct proc *proc;           // The process running on this cpu or null
+  uint64 idle;                 // TSC cycles with nothing to run
+  uint nswitch;                // Context switches onto this cpu
+  uint nintr;                  // Interrupts taken
+  uint vmev[NVMSTAT];          // Memory events, see vmcount()
 };
 
 extern struct cpu cpus[NCPU];
@@ -32,23 +41,54 @@ struct context {
   uint eip;
 };
 
+// A file mapped into user memory by mmap().  Pages are read in
+// from the file on first touch (see mmapfault in mmap.c).
+struct vma {
+  uint addr;                   // Start of region, page aligned; 0 if unused
+  uint len;                    // Length of region in bytes, page aligned
+  uint off;                    // File offset that addr maps to
+  int prot;                    // PROT_READ, optionally PROT_WRITE
+  struct file *f;              // Backing file; the vma holds a reference
+};
+
 enum procstate { UNUSED, EMBRYO, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
 struct proc {
   uint sz;                     // Size of process memory (bytes)
+  uint stackbot, stacktop;     // User stack region, see stackfault()
+  uint stacklow;               // Lowest stack page given out so far
+  uint rss;                    // User pages resident in memory
+  uint ptpages;                // Page table pages, directory included
   uint start_ticks;              //Time the process started in milliseconds.
   pde_t* pgdir;                // Page table
   char *kstack;                // Bottom of kernel stack for this process
+  char *vdso;                  // Identity page mapped at VDSO_PROC
   enum procstate state;        // Process state
+  uint seq;                    // Odd while being renamed or freed, see procseq()
   uint pid;                    // Process ID
+  struct proc *anext, *aprev;  // Processes in use, see ptable.all
+  struct proc *hnext;          // Next in its pid hash chain
+  uint affinity;               // CPUs it may run on, bit i for CPU i
+  int lastcpu;                 // CPU it last ran on, or -1
 #ifdef CS333_P2
   uint uid;                     //User ID
   uint gid;                     //Group ID
-  uint cpu_ticks_total;         //Total ellapsed ticks in the CPU
-  uint cpu_ticks_in;            //ticks when scheduled.
+  uint64 cpu_cycles_total;      //TSC cycles spent running.
+  uint64 cpu_cycles_in;         //TSC when scheduled.
 #endif
   struct proc *parent;         // Parent process. NULL indicates no parent
+#ifdef CS333_P4
+  uint prio;                    //Priority (ready queue) of the process.
+  uint epoch;                   //Promotion epoch prio is current for.
+  int budget;                   //Microseconds left before demotion.
+  uint tickets;                 //Stride tickets; 0 if scheduled by MLFQ.
+  uint stride;                  //STRIDE1 / tickets.
+  uint64 pass;                  //Stride virtual time.
+  int inherit;                  //Priority lent by sleeplock waiters, or -1.
+  uint inhepoch;                //Promotion epoch inherit is current for.
+  struct sleeplock *waitlock;   //Sleeplock it is waiting for, or 0.
+#endif  //CS333_P4
 #ifdef CS333_P3
   struct proc *next;           //Ptr to the next processs in the same state list.
 #endif  //CS333_P3
@@ -56,8 +96,13 @@ struct proc {
   struct context *context;     // swtch() here to run process
   void *chan;                  // If non-zero, sleeping on chan
   int killed;                  // If non-zero, have been killed
+  int swapok;                  // Preempted in user mode; see evict()
+  struct rlimit rlim[NRLIMIT]; // Resource limits
+  uint vmev[NVMSTAT];          // Memory events it caused
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  struct vma vmas[NMMAP];      // Memory-mapped files
+  struct ioring *ioring;       // Registered I/O ring (user address), or 0
   char name[16];               // Process name (debugging)
 };
 
@@ -0,0 +1,152 @@
+//
+// Sampling profiler driven by the local APIC timer.
+//
+// While sampling is on, every n-th timer interrupt on each CPU
+// records the interrupted pc and, if it was in the kernel, the
+// first few return addresses of the %ebp chain.  Samples go into
+// a ring owned by that CPU, so the interrupt handler takes no lock:
+// it is the only writer of head, and readers, serialized by
+// kproflock, are the only writers of tail.  A full ring drops new
+// samples and counts them.
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "x86.h"
+#include "spinlock.h"
+#include "kprof.h"
+
+#define NKPROF 1024  // samples buffered per CPU
+
+static struct {
+  struct kprofsample buf[NKPROF];
+  volatile uint head;  // next slot to fill
+  volatile uint tail;  // next sample to read
+  uint tick;           // timer ticks since the last sample
+  uint drops;
+} rings[NCPU];
+
+static struct spinlock kproflock;
+static volatile int kprofinterval;  // 0 when sampling is off
+
+void
+kprofinit(void)
+{
+  initlock(&kproflock, "kprof");
+}
+
+// Called by the timer interrupt on every CPU.
+void
+kprofsample(struct trapframe *tf)
+{
+  struct cpu *c;
+  struct kprofsample *s;
+  uint *ebp;
+  char *lo, *hi;
+  int i, n;
+
+  if((n = kprofinterval) == 0)
+    return;
+  c = mycpu();
+  i = c - cpus;
+  if(++rings[i].tick < n)
+    return;
+  rings[i].tick = 0;
+  if(rings[i].head - rings[i].tail == NKPROF){
+    rings[i].drops++;
+    return;
+  }
+
+  s = &rings[i].buf[rings[i].head % NKPROF];
+  s->eip = tf->eip;
+  s->cpu = i;
+  s->pid = c->proc ? c->proc->pid : 0;
+  memset(s->pcs, 0, sizeof(s->pcs));
+  if((tf->cs&3) == 0){    // interrupted the kernel
+    // Follow frames only within the stack that was interrupted,
+    // which holds tf: the process's kernel stack, or else the
+    // page of the scheduler's stack.  Kernel stacks have unmapped
+    // guard pages between them.
+    lo = (char*)PGROUNDDOWN((uint)tf);
+    hi = lo + PGSIZE;
+    if(c->proc && (char*)tf >= c->proc->kstack &&
+       (char*)tf < c->proc->kstack + KSTACKSIZE){
+      lo = c->proc->kstack;
+      hi = lo + KSTACKSIZE;
+    }
+    ebp = (uint*)tf->ebp;
+    for(i = 0; i < KPROF_DEPTH; i++){
+      if((char*)ebp < lo || (char*)(ebp + 2) > hi)
+        break;
+      s->pcs[i] = ebp[1];     // saved %eip
+      ebp = (uint*)ebp[0];    // saved %ebp
+    }
+  }
+
+  // Publish the sample only once it is complete.
+  __sync_synchronize();
+  rings[c - cpus].head++;
+}
+
+// Control the profiler and read its samples.
+// kprof(KPROF_ON, 0, n) samples every n-th tick.
+// kprof(KPROF_READ, buf, n) moves up to n samples into buf and
+// returns how many it moved.  The other commands return 0, or
+// the drop count for KPROF_DROPS.
+int
+sys_kprof(void)
+{
+  int cmd, n, c, got;
+  uint head, tail, drops;
+  struct kprofsample *buf;
+
+  if(argint(0, &cmd) < 0)
+    return -1;
+  switch(cmd){
+  case KPROF_OFF:
+    kprofinterval = 0;
+    return 0;
+  case KPROF_ON:
+    if(argint(2, &n) < 0 || n < 1)
+      return -1;
+    acquire(&kproflock);
+    for(c = 0; c < ncpu; c++){
+      rings[c].drops = 0;
+      rings[c].tick = 0;
+    }
+    kprofinterval = n;
+    release(&kproflock);
+    return 0;
+  case KPROF_DROPS:
+    drops = 0;
+    for(c = 0; c < ncpu; c++)
+      drops += rings[c].drops;
+    return drops;
+  case KPROF_READ:
+    if(argint(2, &n) < 0 || n < 0)
+      return -1;
+    // No more than the rings can hold, so n*sizeof(*buf) cannot wrap.
+    if(n > ncpu*NKPROF)
+      n = ncpu*NKPROF;
+    if(argptr(1, (void*)&buf, n*sizeof(*buf)) < 0)
+      return -1;
+    got = 0;
+    acquire(&kproflock);
+    for(c = 0; c < ncpu && got < n; c++){
+      head = rings[c].head;
+      __sync_synchronize();
+      for(tail = rings[c].tail; tail != head && got < n; tail++)
+        buf[got++] = rings[c].buf[tail % NKPROF];
+      // Hand the slots back only after they have been copied.
+      __sync_synchronize();
+      rings[c].tail = tail;
+    }
+    release(&kproflock);
+    return got;
+  }
+  return -1;
+}
@@ -9,20 +9,7 @@
 #include "user.h"
 #include "uproc.h"
 
-#define MAX 64
-
-static int
-call_getprocs(uint max, struct uproc ** table)
-{
-  (*table) = (struct uproc *) malloc(sizeof(struct uproc)*max);
-  if(!(*table))
-  {
-    printf(2, "Error: malloc() call failed. %s at line %d\n", __FUNCTION__, __LINE__);
-    return -1;
-  }
-  return getprocs(max, (*table));
-}
-
+#define BATCH 16  // processes fetched per procquery() call
 
 static void
 output_ticks(int ticks)
@@ -42,42 +29,86 @@ output_ticks(int ticks)
       else printf(1, "%d\t", tick_milliseconds);
 }
 
+// CPU time as seconds and microseconds.
+static void
+output_us(uint us)
+{
+  uint frac = us % 1000000;
+  uint digits;
+
+  printf(1, "%d.", us / 1000000);
+  for(digits = 100000; digits > 1 && frac < digits; digits /= 10)
+    printf(1, "0");
+  printf(1, "%d\t", frac);
+}
+
 static void
 display_procs(int num_copied, struct uproc * table)
 {
-  if(num_copied < 0)
-    printf(2, "__ERROR__\n");
-  else {
-    printf(1, "\nPID\tName\t\tUID\tGID\tPPID\tElapsed\tCPU\tState\tSize\n");
-    for(int i = 0; i < num_copied; ++i)
-    {
-      printf(1, "%d\t%s\t", table[i].pid, table[i].name);
-      if(strlen(table[i].name) < 9)
-        printf(1, "\t");
-      printf(1, "%d\t%d\t", table[i].uid, table[i].gid);
-      printf(1, "%d\t", table[i].ppid);
-      
-      output_ticks(table[i].elapsed_ticks);
-      output_ticks(table[i].CPU_total_ticks);
-
-      //printf(1, "%d\t", table[i].CPU_total_ticks);
-      printf(1, "%s\t%d\t\n", table[i].state, table[i].size);
-    }
+  for(int i = 0; i < num_copied; ++i)
+  {
+    printf(1, "%d\t%s\t", table[i].pid, table[i].name);
+    if(strlen(table[i].name) < 9)
+      printf(1, "\t");
+    printf(1, "%d\t%d\t", table[i].uid, table[i].gid);
+    printf(1, "%d\t", table[i].ppid);
+
+    output_ticks(table[i].elapsed_ticks);
+    output_us(table[i].CPU_total_us);
+    printf(1, "%s\t%d\t%d\t%d\t%d\t%x\n", table[i].state, table[i].size,
+           table[i].rss, table[i].ptpages, table[i].kmem, table[i].affinity);
   }
 }
 
+static void
+usage(void)
+{
+  printf(2, "usage: ps [-r] [-u uid] [-p pid | -p min-max]\n");
+  exit();
+}
 
+// Parse "n" or "min-max" into the query's pid range.
+static void
+pidrange(char *s, struct procquery *q)
+{
+  q->minpid = q->maxpid = atoi(s);
+  while(*s >= '0' && *s <= '9')
+    s++;
+  if(*s == '-')
+    q->maxpid = atoi(s + 1);
+  else if(*s)
+    usage();
+}
+
+// Options select which processes to list:
+//   -r           only running and runnable ones
+//   -u uid       only those of user uid
+//   -p pid       only pid, or pids min to max with -p min-max
 int
-main(void)
+main(int argc, char *argv[])
 {
-  int num_copied;
-  uint max = MAX;
-  struct uproc * table;
-
-  num_copied = call_getprocs(max, &table);
-  display_procs(num_copied, table);
-  if(num_copied != -1)
-    free(table);
+  struct procquery q;
+  struct uproc table[BATCH];
+  int i, n;
+
+  memset(&q, 0, sizeof(q));
+  q.uid = -1;
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-r") == 0)
+      q.states = PQ_RUNNING | PQ_RUNNABLE;
+    else if(strcmp(argv[i], "-u") == 0 && i + 1 < argc)
+      q.uid = atoi(argv[++i]);
+    else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+      pidrange(argv[++i], &q);
+    else
+      usage();
+  }
+
+  printf(1, "\nPID\tName\t\tUID\tGID\tPPID\tElapsed\tCPU\tState\tSize\tRSS\tPT\tKmem\tCPUs\n");
+  while((n = procquery(&q, table, BATCH)) > 0)
+    display_procs(n, table);
+  if(n < 0)
+    printf(2, "__ERROR__\n");
 
   exit();
 }
@@ -0,0 +1,149 @@
+// Compare plain read()/write() loops with the same I/O batched
+// through the submission ring (see ioring.h).
+
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+#include "ioring.h"
+
+#define CHUNK 16          // bytes per request
+#define BATCH 16          // requests per ioring_enter()
+#define PIPEROUNDS 2000   // rounds of BATCH writes then BATCH reads
+#define FILEBYTES 8192
+#define FILEPASSES 20
+
+struct ioring ring;
+char buf[FILEBYTES];
+int errors;
+
+static void
+queue(int op, int fd, void *addr, int len)
+{
+  struct iosqe *e;
+
+  e = &ring.sq[ring.sqtail % IORING_SIZE];
+  e->op = op;
+  e->fd = fd;
+  e->addr = (uint)addr;
+  e->len = len;
+  e->flags = 0;
+  e->data = len;
+  ring.sqtail++;
+}
+
+// Submit everything queued and check that each request moved as
+// many bytes as it asked for.
+static void
+flush(void)
+{
+  int n;
+
+  while(ring.sqhead != ring.sqtail){
+    n = ioring_enter(ring.sqtail - ring.sqhead);
+    if(n <= 0){
+      printf(2, "ringbench: ioring_enter failed\n");
+      exit();
+    }
+    while(ring.cqhead != ring.cqtail){
+      if(ring.cq[ring.cqhead % IORING_SIZE].res !=
+         ring.cq[ring.cqhead % IORING_SIZE].data)
+        errors++;
+      ring.cqhead++;
+    }
+  }
+}
+
+static void
+report(char *what, int plain, int batched, int ops)
+{
+  printf(1, "%s: %d ops, plain %d ms, ring %d ms\n",
+         what, ops, plain, batched);
+}
+
+static void
+pipebench(void)
+{
+  int fds[2], i, j, start, plain;
+
+  if(pipe(fds) < 0){
+    printf(2, "ringbench: pipe failed\n");
+    exit();
+  }
+
+  start = uptime();
+  for(i = 0; i < PIPEROUNDS; i++){
+    for(j = 0; j < BATCH; j++)
+      if(write(fds[1], buf + j*CHUNK, CHUNK) != CHUNK)
+        errors++;
+    for(j = 0; j < BATCH; j++)
+      if(read(fds[0], buf + j*CHUNK, CHUNK) != CHUNK)
+        errors++;
+  }
+  plain = uptime() - start;
+
+  start = uptime();
+  for(i = 0; i < PIPEROUNDS; i++){
+    for(j = 0; j < BATCH; j++)
+      queue(IORING_WRITE, fds[1], buf + j*CHUNK, CHUNK);
+    for(j = 0; j < BATCH; j++)
+      queue(IORING_READ, fds[0], buf + j*CHUNK, CHUNK);
+    flush();
+  }
+  report("pipe", plain, uptime() - start, 2*BATCH*PIPEROUNDS);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+static void
+filebench(void)
+{
+  int fd, i, j, start, plain;
+
+  if((fd = open("ringbench.dat", O_CREATE|O_RDWR)) < 0 ||
+     write(fd, buf, FILEBYTES) != FILEBYTES){
+    printf(2, "ringbench: cannot create ringbench.dat\n");
+    exit();
+  }
+  close(fd);
+
+  start = uptime();
+  for(i = 0; i < FILEPASSES; i++){
+    fd = open("ringbench.dat", O_RDONLY);
+    for(j = 0; j < FILEBYTES; j += CHUNK)
+      if(read(fd, buf + j, CHUNK) != CHUNK)
+        errors++;
+    close(fd);
+  }
+  plain = uptime() - start;
+
+  start = uptime();
+  for(i = 0; i < FILEPASSES; i++){
+    fd = open("ringbench.dat", O_RDONLY);
+    for(j = 0; j < FILEBYTES; j += CHUNK){
+      queue(IORING_READ, fd, buf + j, CHUNK);
+      if(ring.sqtail - ring.sqhead == BATCH)
+        flush();
+    }
+    flush();
+    close(fd);
+  }
+  report("file read", plain, uptime() - start,
+         FILEPASSES * FILEBYTES / CHUNK);
+
+  unlink("ringbench.dat");
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(ioring_setup(&ring) < 0){
+    printf(2, "ringbench: ioring_setup failed\n");
+    exit();
+  }
+  pipebench();
+  filebench();
+  if(errors)
+    printf(1, "ringbench: %d requests came up short\n", errors);
+  exit();
+}
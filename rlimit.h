@@ -0,0 +1,15 @@
+// Per-process resource limits for getrlimit() and setrlimit().
+// Visible to both user and kernel space.
+
+#define RLIMIT_MEM     0   // bytes of user memory (sz less unused stack)
+#define RLIMIT_NOFILE  1   // open file descriptors
+#define RLIMIT_CPU     2   // seconds of CPU time; killed past it (CS333_P2)
+#define RLIMIT_STACK   3   // bytes the user stack may grow to, from exec()
+#define NRLIMIT        4
+
+#define RLIM_INFINITY  0xffffffff
+
+struct rlimit {
+  uint cur;              // enforced limit
+  uint max;              // ceiling for cur; only root may raise it
+};
@@ -0,0 +1,143 @@
+// Test of setrlimit().  The test lowers its own memory and file
+// limits and tries to go past them; a child spins past a CPU limit
+// of a second and must be killed for it before a second child,
+// a timer, finishes sleeping ten.
+
+#include "types.h"
+#include "user.h"
+#include "rlimit.h"
+
+#define PAGE 4096
+#define STACKROOM (256*PAGE)  // stack region exec() sets aside by default
+
+static void
+fail(char *msg)
+{
+  printf(1, "rlimittest: FAILED: %s\n", msg);
+  exit();
+}
+
+static void
+setlimit(int r, uint cur)
+{
+  struct rlimit rl;
+
+  if(getrlimit(r, &rl) < 0)
+    fail("getrlimit");
+  rl.cur = cur;
+  if(setrlimit(r, &rl) < 0)
+    fail("setrlimit");
+}
+
+static void
+memlimit(void)
+{
+  char *top;
+
+  top = sbrk(0);
+  setlimit(RLIMIT_MEM, (uint)top + 4*PAGE);
+  if(sbrk(4*PAGE) == (char*)-1)
+    fail("sbrk within RLIMIT_MEM refused");
+  // The part of the stack region not yet used does not count, so
+  // go past the limit by more than all of it.
+  if(sbrk(STACKROOM + PAGE) != (char*)-1)
+    fail("sbrk past RLIMIT_MEM allowed");
+  sbrk(-4*PAGE);
+}
+
+// A limit far below the stack region exec() sets aside must still
+// let a small program run.
+static void
+execlimit(void)
+{
+  char *argv[] = { "rlimittest", "exit", 0 };
+  int pid;
+
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0){
+    setlimit(RLIMIT_MEM, 64*PAGE);
+    exec(argv[0], argv);
+    fail("exec under a small RLIMIT_MEM");
+  }
+  wait();
+}
+
+static void
+filelimit(void)
+{
+  int fd;
+
+  setlimit(RLIMIT_NOFILE, 4);
+  if((fd = dup(0)) != 3)
+    fail("dup within RLIMIT_NOFILE refused");
+  if(dup(0) >= 0)
+    fail("dup past RLIMIT_NOFILE allowed");
+  close(fd);
+}
+
+static void
+hardlimit(void)
+{
+  struct rlimit rl;
+
+  rl.cur = rl.max = 8;
+  if(setrlimit(RLIMIT_NOFILE, &rl) < 0)
+    fail("lowering the hard limit refused");
+  rl.cur = 9;
+  if(setrlimit(RLIMIT_NOFILE, &rl) == 0)
+    fail("soft limit above the hard limit allowed");
+}
+
+#ifdef CS333_P2
+static void
+cpulimit(void)
+{
+  volatile int i;
+  int spinner, timer;
+
+  spinner = fork();
+  if(spinner < 0)
+    fail("fork");
+  if(spinner == 0){
+    setlimit(RLIMIT_CPU, 1);
+    for(;;)
+      for(i = 0; i < 1000000; i++)
+        ;
+  }
+  timer = fork();
+  if(timer < 0){
+    kill(spinner);
+    wait();
+    fail("fork");
+  }
+  if(timer == 0){
+    sleep(10 * TPS);
+    exit();
+  }
+  if(wait() == timer){
+    kill(spinner);
+    wait();
+    fail("RLIMIT_CPU did not stop a spinning child");
+  }
+  kill(timer);
+  wait();
+}
+#endif  //CS333_P2
+
+int
+main(int argc, char *argv[])
+{
+  if(argc > 1)  // run by execlimit()
+    exit();
+  execlimit();
+  memlimit();
+  filelimit();
+  hardlimit();
+#ifdef CS333_P2
+  cpulimit();
+#endif  //CS333_P2
+  printf(1, "rlimittest: PASSED\n");
+  exit();
+}
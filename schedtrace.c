@@ -0,0 +1,243 @@
+// Dump the scheduler event trace (see schedtrace.h) as text.
+//
+//   schedtrace on | off             control tracing
+//   schedtrace [-l]                 print buffered events, oldest
+//                                   first; -l instead summarizes
+//                                   run-queue latency per process
+//   schedtrace run [-l] cmd ...     trace while cmd runs, then print
+
+#include "types.h"
+#include "user.h"
+#include "x86.h"
+#include "schedtrace.h"
+
+#define MAXEV   8192
+#define MAXPID  64    // processes tracked by -l
+
+struct schedevent ev[MAXEV], tmp[MAXEV];
+int nev;
+uint kpt;  // 1024-cycle units per clock tick
+
+char *names[] = {
+  [SEV_ENQUEUE] "enqueue",
+  [SEV_DEQUEUE] "dequeue",
+  [SEV_SWITCH]  "switch",
+  [SEV_SLEEP]   "sleep",
+  [SEV_WAKEUP]  "wakeup",
+  [SEV_DEMOTE]  "demote",
+  [SEV_PROMOTE] "promote",
+  [SEV_BOOST]   "boost",
+};
+
+// Run-queue latency: time from being made runnable to being
+// picked to run.
+struct lat {
+  int pid;
+  uint64 ready;  // TSC when last made runnable, 0 if not waiting
+  uint count;
+  uint64 total;
+  uint64 max;
+} lats[MAXPID];
+
+// Estimate the TSC rate against the clock tick.
+static void
+calibrate(void)
+{
+  uint t0;
+  uint64 c0;
+
+  t0 = uptime();
+  while(uptime() == t0)
+    ;
+  t0 = uptime();
+  c0 = rdtsc();
+  while(uptime() < t0 + 10)
+    ;
+  kpt = (uint)((rdtsc() - c0) >> 10) / 10;
+  if(kpt == 0)
+    kpt = 1;
+}
+
+// Convert cycles to microseconds without 64-bit division.
+static uint
+tous(uint64 cycles)
+{
+  uint k = cycles >> 10;
+  uint uspt = 1000000 / TPS;
+
+  if(k < 0xffffffff / uspt)
+    return k * uspt / kpt;
+  return k / kpt * uspt;
+}
+
+// Read everything buffered, then merge the per-CPU runs into one
+// stream in time order.
+static void
+readall(void)
+{
+  int n, w, lo, mid, hi, i, j, k;
+
+  while(nev < MAXEV &&
+        (n = schedtrace(STRACE_READ, ev + nev, MAXEV - nev)) > 0)
+    nev += n;
+
+  // Bottom-up merge sort on the time stamp.
+  for(w = 1; w < nev; w *= 2){
+    for(lo = 0; lo < nev; lo += 2*w){
+      mid = lo + w < nev ? lo + w : nev;
+      hi = lo + 2*w < nev ? lo + 2*w : nev;
+      i = lo;
+      j = mid;
+      for(k = lo; k < hi; k++){
+        if(i < mid && (j >= hi || ev[i].tsc <= ev[j].tsc))
+          tmp[k] = ev[i++];
+        else
+          tmp[k] = ev[j++];
+      }
+    }
+    memmove(ev, tmp, nev * sizeof(ev[0]));
+  }
+}
+
+static void
+printevents(void)
+{
+  struct schedevent *e;
+  char *name;
+
+  printf(1, "time(us)\tcpu\tevent\tpid\targ\n");
+  for(e = ev; e < &ev[nev]; e++){
+    name = "?";
+    if(e->type < sizeof(names)/sizeof(names[0]) && names[e->type])
+      name = names[e->type];
+    printf(1, "%d\t\t%d\t%s\t%d\t%d\n", tous(e->tsc - ev[0].tsc), e->cpu,
+           name, e->pid, e->arg);
+  }
+}
+
+static struct lat*
+findlat(int pid)
+{
+  struct lat *l, *free;
+
+  free = 0;
+  for(l = lats; l < &lats[MAXPID]; l++){
+    if(l->pid == pid)
+      return l;
+    if(free == 0 && l->pid == 0)
+      free = l;
+  }
+  if(free)
+    free->pid = pid;
+  return free;
+}
+
+static void
+printlatency(void)
+{
+  struct schedevent *e;
+  struct lat *l;
+  uint64 d;
+
+  for(e = ev; e < &ev[nev]; e++){
+    if(e->pid == 0 || (l = findlat(e->pid)) == 0)
+      continue;
+    switch(e->type){
+    case SEV_ENQUEUE:
+    case SEV_WAKEUP:
+      if(l->ready == 0)
+        l->ready = e->tsc;
+      break;
+    case SEV_DEQUEUE:
+      if(l->ready){
+        d = e->tsc - l->ready;
+        l->count++;
+        l->total += d;
+        if(d > l->max)
+          l->max = d;
+        l->ready = 0;
+      }
+      break;
+    }
+  }
+
+  printf(1, "pid\twaits\tavg(us)\tmax(us)\n");
+  for(l = lats; l < &lats[MAXPID]; l++)
+    if(l->count)
+      printf(1, "%d\t%d\t%d\t%d\n", l->pid, l->count,
+             tous(l->total) / l->count, tous(l->max));
+}
+
+static void
+report(int latency)
+{
+  int lost;
+
+  lost = schedtrace(STRACE_DROPS, 0, 0);
+  readall();
+  calibrate();
+  if(latency)
+    printlatency();
+  else
+    printevents();
+  if(lost)
+    printf(1, "schedtrace: %d events lost to full buffers\n", lost);
+  if(nev == MAXEV)
+    printf(1, "schedtrace: only the first %d events read\n", MAXEV);
+}
+
+static void
+run(char **argv)
+{
+  int pid;
+
+  // Throw away whatever an earlier run left behind.
+  while(schedtrace(STRACE_READ, ev, MAXEV) > 0)
+    ;
+  schedtrace(STRACE_ON, 0, 0);
+  pid = fork();
+  if(pid < 0){
+    printf(2, "schedtrace: fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    exec(argv[0], argv);
+    printf(2, "schedtrace: exec %s failed\n", argv[0]);
+    exit();
+  }
+  wait();
+  schedtrace(STRACE_OFF, 0, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int l;
+
+  if(argc == 2 && strcmp(argv[1], "on") == 0){
+    schedtrace(STRACE_ON, 0, 0);
+    exit();
+  }
+  if(argc == 2 && strcmp(argv[1], "off") == 0){
+    schedtrace(STRACE_OFF, 0, 0);
+    exit();
+  }
+
+  l = 0;
+  if(argc >= 2 && strcmp(argv[1], "run") == 0){
+    l = argc > 2 && strcmp(argv[2], "-l") == 0;
+    if(argc < 3 + l){
+      printf(2, "usage: schedtrace run [-l] cmd [args]\n");
+      exit();
+    }
+    run(argv + 2 + l);
+  } else if(argc == 2 && strcmp(argv[1], "-l") == 0)
+    l = 1;
+  else if(argc != 1){
+    printf(2, "usage: schedtrace [on | off | -l | run [-l] cmd [args]]\n");
+    exit();
+  }
+
+  report(l);
+  exit();
+}
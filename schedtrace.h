@@ -0,0 +1,26 @@
+// Scheduler event trace (see evtrace.c).
+// Visible to both user and kernel space.
+
+// Commands for schedtrace()
+#define STRACE_OFF    0   // stop tracing
+#define STRACE_ON     1   // start tracing
+#define STRACE_READ   2   // move buffered events into buf
+#define STRACE_DROPS  3   // events lost to full buffers since STRACE_ON
+
+// Events
+#define SEV_ENQUEUE   1   // pid put on a ready list; arg is its priority
+#define SEV_DEQUEUE   2   // pid taken off a ready list to run
+#define SEV_SWITCH    3   // cpu switched from pid to arg; 0 is the scheduler
+#define SEV_SLEEP     4   // pid went to sleep
+#define SEV_WAKEUP    5   // pid woken up
+#define SEV_DEMOTE    6   // pid used up its budget; arg is its new priority
+#define SEV_PROMOTE   7   // pid raised to priority arg
+#define SEV_BOOST     8   // periodic promotion number arg began
+
+struct schedevent {
+  uint64 tsc;      // time stamp counter when it happened
+  ushort type;     // SEV_*
+  ushort cpu;
+  int pid;
+  int arg;
+};
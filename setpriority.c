@@ -1,24 +1,47 @@
 //Joseph Jesse
 //Test program to test the setpriority system call.
+//
+//  setpriority pid [pid ...] prio   set the priority of each pid
+//  setpriority -g gid prio          of every process in group gid
 
 #include "types.h"
 #include "user.h"
 
+#define MAXPIDS 64
+
 int
 main(int argc, char * argv[])
 {
-  if(argc != 3) {
-    printf(2, "Wrong number of command line args... exiting\n");
+  int pids[MAXPIDS];
+  int i, n, prio;
+
+  if(argc < 3 || argc - 2 > MAXPIDS) {
+    printf(2, "usage: setpriority pid [pid ...] prio | -g gid prio\n");
     exit();
   }
 
-  int pid = atoi(argv[1]);
-  int prio = atoi(argv[2]);
+  prio = atoi(argv[argc - 1]);
+
+  if(strcmp(argv[1], "-g") == 0) {
+    if(argc != 4 || setprioritygroup(atoi(argv[2]), prio) < 0) {
+      printf(2, "Error when attempting to set priority... exiting\n");
+      exit();
+    }
+    exit();
+  }
 
-  if(setpriority(pid, prio) < 0) {
-    printf(2, "Error when attempting to set priority... exiting\n");
+  if(argc == 3) {
+    if(setpriority(atoi(argv[1]), prio) < 0) {
+      printf(2, "Error when attempting to set priority... exiting\n");
+      exit();
+    }
     exit();
   }
-  
+
+  n = argc - 2;
+  for(i = 0; i < n; i++)
+    pids[i] = atoi(argv[i + 1]);
+  if(setprioritylist(pids, n, prio) != n)
+    printf(2, "setpriority: some pids not found\n");
   exit();
 }
@@ -51,7 +51,8 @@ struct backcmd {
 };
 
 int fork1(void);  // Fork but panics on failure.
-void panic(char*);
+void panic(char*) __attribute__((noreturn));
+void runcmd(struct cmd*) __attribute__((noreturn));
 struct cmd *parsecmd(char*);
 
 // Execute cmd.  Never returns.
@@ -10,6 +10,8 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 
+#define SPINLIMIT 4096
+
 void
 initsleeplock(struct sleeplock *lk, char *name)
 {
@@ -17,17 +19,53 @@ initsleeplock(struct sleeplock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+  lk->holder = 0;
+  lk->waiters = 0;
+}
+
+// Is the holder of lk running, and so on another CPU and likely
+// to let go soon?  Only a hint: nothing stops it from changing.
+static int
+holderrunning(struct sleeplock *lk)
+{
+  struct proc *p = lk->holder;
+
+  return p != 0 && p->state == RUNNING;
 }
 
+// Buffer and inode locks are mostly held for a few microseconds,
+// less than sleep() and wakeup() cost.  So while the holder is
+// running, spin for up to SPINLIMIT pauses before sleeping.
 void
 acquiresleep(struct sleeplock *lk)
 {
+  int spins = 0;
+
   acquire(&lk->lk);
   while (lk->locked) {
+    if(spins < SPINLIMIT && holderrunning(lk)){
+      release(&lk->lk);
+      while(lk->locked && holderrunning(lk) && spins++ < SPINLIMIT)
+        pause();
+      acquire(&lk->lk);
+      continue;
+    }
+#ifdef CS333_P4
+    priolend(lk);
+#endif
+    lk->waiters++;
     sleep(lk, &lk->lk);
+    lk->waiters--;
+    spins = 0;
   }
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  lk->holder = myproc();
+#ifdef CS333_P4
+  // Inherit from those still waiting, and stop lending.
+  if(lk->waiters || myproc()->waitlock)
+    prioreturn();
+#endif
   release(&lk->lk);
 }
 
@@ -37,7 +75,13 @@ releasesleep(struct sleeplock *lk)
   acquire(&lk->lk);
   lk->locked = 0;
   lk->pid = 0;
-  wakeup(lk);
+  lk->holder = 0;
+#ifdef CS333_P4
+  if(myproc()->inherit >= 0)
+    prioreturn();
+#endif
+  if(lk->waiters)
+    wakeup(lk);
   release(&lk->lk);
 }
 
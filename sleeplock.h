@@ -2,6 +2,8 @@
 struct sleeplock {
   uint locked;       // Is the lock held?
   struct spinlock lk; // spinlock protecting this sleep lock
+  struct proc *holder; // Process holding lock, for priority inheritance
+  int waiters;       // Processes sleeping until it is released
   
   // For debugging:
   char *name;        // Name of lock.
@@ -0,0 +1,104 @@
+// Test of the growable user stack.  Deep recursion must work
+// without sbrk(), a read() into a stack buffer the program has not
+// touched must land there, the heap must not shrink into the
+// stack, and a child that recurses past its RLIMIT_STACK must be
+// killed rather than run into the heap.
+
+#include "types.h"
+#include "user.h"
+#include "fcntl.h"
+#include "rlimit.h"
+
+#define PAGE   4096
+#define FRAME  1024      // bytes of stack per level of recursion
+
+static void
+fail(char *msg)
+{
+  printf(1, "stacktest: FAILED: %s\n", msg);
+  exit();
+}
+
+// Recurse depth levels, writing every frame on the way down and
+// checking it on the way back up.
+static int
+recurse(int depth)
+{
+  volatile char frame[FRAME];
+  int i, sum;
+
+  for(i = 0; i < FRAME; i++)
+    frame[i] = depth + i;
+  sum = depth > 0 ? recurse(depth - 1) : 0;
+  for(i = 0; i < FRAME; i++)
+    if(frame[i] != (char)(depth + i))
+      fail("stack frame corrupted");
+  return sum + 1;
+}
+
+static void
+untouched(void)
+{
+  char buf[8*PAGE];
+  int fd, n;
+
+  if((fd = open("README", O_RDONLY)) < 0)
+    fail("cannot open README");
+  n = read(fd, buf, sizeof(buf));
+  close(fd);
+  if(n <= 0)
+    fail("read into an untouched stack buffer");
+}
+
+// The heap must not shrink into the stack region below it.  If it
+// could, touching the stack there would map a page past sz, and
+// growing the heap back over that page would panic the kernel.
+// Run first, while sz is still the top of the stack region.
+static void
+shrink(void)
+{
+  if(sbrk(-64 * 1024) != (char*)-1)
+    fail("heap shrank into the stack");
+  if(recurse(128 * 1024 / FRAME) != 128 * 1024 / FRAME + 1)
+    fail("recursion after shrink");
+  if(sbrk(64 * 1024) == (char*)-1)
+    fail("sbrk after shrink");
+  sbrk(-64 * 1024);
+}
+
+int
+main(void)
+{
+  struct rlimit rl;
+  int pid, depth, fds[2];
+  char c;
+
+  shrink();
+
+  // 512KB of stack, half the default limit.
+  depth = 512 * 1024 / FRAME;
+  if(recurse(depth) != depth + 1)
+    fail("recursion");
+  untouched();
+
+  if(pipe(fds) < 0)
+    fail("pipe");
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0){
+    getrlimit(RLIMIT_STACK, &rl);
+    rl.cur = 64 * 1024;
+    if(setrlimit(RLIMIT_STACK, &rl) < 0)
+      fail("setrlimit");
+    recurse(128 * 1024 / FRAME);
+    write(fds[1], "x", 1);
+    exit();
+  }
+  close(fds[1]);
+  if(read(fds[0], &c, 1) != 0)
+    fail("recursed past RLIMIT_STACK");
+  wait();
+  printf(1, "stacktest: PASSED\n");
+  exit();
+}
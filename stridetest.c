@@ -0,0 +1,108 @@
+#ifdef CS333_P4
+#include "types.h"
+#include "user.h"
+#include "param.h"
+#include "uproc.h"
+
+// Check that stride-scheduled processes get CPU time in proportion
+// to their tickets.
+//
+// NCHILD CPU-bound children join the stride class with the tickets
+// below, then spin until killed.  After RUNTIME the parent compares
+// each child's share of the CPU time the children used against its
+// share of the tickets.  The largest share must fit on one CPU, so
+// this assumes no more than two CPUs (the Makefile default).
+
+#define NCHILD    3
+#define RUNTIME   (3 * TPS)  // ticks to let the children compete
+#define TOLERANCE 5          // percentage points
+
+int tickets[NCHILD] = { 100, 200, 300 };
+int pids[NCHILD];
+struct uproc table[NPROC];
+
+// CPU time of each child in microseconds.
+static void
+cputimes(uint us[])
+{
+  int n, i, j;
+
+  n = getprocs(NPROC, table);
+  for(i = 0; i < NCHILD; i++){
+    us[i] = 0;
+    for(j = 0; j < n; j++)
+      if(table[j].pid == pids[i])
+        us[i] = table[j].CPU_total_us;
+  }
+}
+
+int
+main(void)
+{
+  uint start[NCHILD], end[NCHILD], total, sum;
+  int fds[2], i, pct, want, failed;
+  char c;
+
+  if(pipe(fds) < 0){
+    printf(2, "stridetest: pipe failed\n");
+    exit();
+  }
+
+  // The children wait on the pipe so that they all start together.
+  for(i = 0; i < NCHILD; i++){
+    pids[i] = fork();
+    if(pids[i] < 0){
+      printf(2, "stridetest: fork failed\n");
+      exit();
+    }
+    if(pids[i] == 0){
+      read(fds[0], &c, 1);
+      for(;;)
+        ;
+    }
+    if(settickets(pids[i], tickets[i]) < 0){
+      printf(2, "stridetest: settickets failed\n");
+      exit();
+    }
+  }
+  if(settickets(getpid(), MAXTICKETS + 1) == 0)
+    printf(2, "stridetest: settickets accepted too many tickets\n");
+
+  cputimes(start);
+  write(fds[1], "go!", NCHILD);
+  sleep(RUNTIME);
+  cputimes(end);
+
+  for(i = 0; i < NCHILD; i++)
+    kill(pids[i]);
+  while(wait() != -1)
+    ;
+
+  total = 0;
+  sum = 0;
+  for(i = 0; i < NCHILD; i++){
+    total += end[i] - start[i];
+    sum += tickets[i];
+  }
+  if(total == 0){
+    printf(1, "stridetest: FAILED: children got no CPU time\n");
+    exit();
+  }
+
+  failed = 0;
+  printf(1, "Tickets\tCPU(ms)\tShare\tExpected\n");
+  for(i = 0; i < NCHILD; i++){
+    pct = (end[i] - start[i]) * 100 / total;
+    want = tickets[i] * 100 / sum;
+    printf(1, "%d\t%d\t%d%%\t%d%%\n", tickets[i],
+           (end[i] - start[i]) / 1000, pct, want);
+    if(pct < want - TOLERANCE || pct > want + TOLERANCE)
+      failed = 1;
+  }
+  if(failed)
+    printf(1, "stridetest: FAILED: shares off by more than %d%%\n", TOLERANCE);
+  else
+    printf(1, "stridetest: PASSED\n");
+  exit();
+}
+#endif
@@ -0,0 +1,204 @@
+//
+// Swap space for user pages.
+//
+// mkfs leaves SWAPPAGES pages of disk after the file system, and the
+// superblock says where.  When kalloc() runs dry, pagealloc() has
+// evict() pick a page of some other process by second chance on
+// PTE_A, copies it out here and gives its frame back.  The PTE is
+// left not present, with PTE_SWAP set and the swap slot in place of
+// the physical address; touching the page again faults into
+// swapin(), which reads it back.
+//
+// Page I/O bypasses the buffer cache and the log: each page moves
+// as BPPG private bufs queued on the disk together with iderwv().
+// swap.lock serializes it, so a page-in of a slot can never
+// overtake the write that filled it.
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+
+struct {
+  struct sleeplock lock;   // held for page I/O
+  struct buf buf[BPPG];
+  char page[PGSIZE];       // page being written out
+  struct spinlock maplock; // protects used
+  uint dev;
+  uint start;
+  uint nswap;              // 0 until swapinit(), or without swap
+  char used[SWAPPAGES];
+} swap;
+
+void
+swapinit(int dev)
+{
+  struct superblock sb;
+  int i;
+
+  initsleeplock(&swap.lock, "swap");
+  initlock(&swap.maplock, "swapmap");
+  for(i = 0; i < BPPG; i++)
+    initsleeplock(&swap.buf[i].lock, "swapbuf");
+  readsb(dev, &sb);
+  swap.dev = dev;
+  swap.start = sb.swapstart;
+  swap.nswap = sb.nswap < SWAPPAGES ? sb.nswap : SWAPPAGES;
+}
+
+// Allocate a swap slot.  Returns -1 if swap is full.
+static int
+slotalloc(void)
+{
+  int i;
+
+  acquire(&swap.maplock);
+  for(i = 0; i < swap.nswap; i++){
+    if(!swap.used[i]){
+      swap.used[i] = 1;
+      release(&swap.maplock);
+      return i;
+    }
+  }
+  release(&swap.maplock);
+  return -1;
+}
+
+// Free the swap slot held by a swapped-out PTE.
+void
+swapfree(uint pte)
+{
+  uint slot = PTE_ADDR(pte) >> PGSHIFT;
+
+  if(!(pte & PTE_SWAP) || slot >= swap.nswap)
+    panic("swapfree");
+  acquire(&swap.maplock);
+  swap.used[slot] = 0;
+  release(&swap.maplock);
+}
+
+// Move the page at mem to or from swap slot slot.
+// Caller must hold swap.lock.
+static void
+swaprw(uint slot, char *mem, int write)
+{
+  struct buf *bs[BPPG];
+  struct buf *b;
+  int i;
+
+  for(i = 0; i < BPPG; i++){
+    b = &swap.buf[i];
+    acquiresleep(&b->lock);
+    b->dev = swap.dev;
+    b->blockno = swap.start + slot*BPPG + i;
+    if(write){
+      memmove(b->data, mem + i*BSIZE, BSIZE);
+      b->flags = B_DIRTY;
+    } else
+      b->flags = 0;
+    bs[i] = b;
+  }
+  iderwv(bs, BPPG);
+  for(i = 0; i < BPPG; i++){
+    b = &swap.buf[i];
+    if(!write)
+      memmove(mem + i*BSIZE, b->data, BSIZE);
+    releasesleep(&b->lock);
+  }
+}
+
+// Push one user page out to swap.  Returns 0 if a page was freed,
+// or -1 if swap is full or no page can be taken.
+static int
+swapout(void)
+{
+  int slot;
+
+  acquiresleep(&swap.lock);
+  if((slot = slotalloc()) < 0){
+    releasesleep(&swap.lock);
+    return -1;
+  }
+  if(evict(swap.page, slot) < 0){
+    acquire(&swap.maplock);
+    swap.used[slot] = 0;
+    release(&swap.maplock);
+    releasesleep(&swap.lock);
+    return -1;
+  }
+  swaprw(slot, swap.page, 1);
+  releasesleep(&swap.lock);
+  vmcount(0, VM_SWAPOUT);   // evict() counted it for the owner
+  return 0;
+}
+
+// Allocate a page for user memory of pgdir, zeroed if zero is set,
+// swapping out other pages to make room if need be.  May sleep,
+// so the caller must not hold any spinlock.  Returns 0 if memory
+// and swap are both full.
+char*
+pagealloc(pde_t *pgdir, int zero)
+{
+  char *mem;
+
+  while((mem = zero ? kzalloc() : kalloc()) == 0)
+    if(swapout() < 0)
+      return 0;
+  vmcount(pgdir, VM_PGALLOC);
+  return mem;
+}
+
+// Bring the page at va in pgdir back in if it was swapped out.
+// Returns 0 if the page is in memory now, -1 if it is not
+// swapped out at all or there is no memory for it.
+int
+swapin(pde_t *pgdir, uint va)
+{
+  pte_t *pte;
+  char *mem;
+
+  pte = walkpgdir(pgdir, (char*)va, 0);
+  if(pte == 0 || !(*pte & PTE_SWAP))
+    return -1;
+  if((mem = pagealloc(pgdir, 0)) == 0)
+    return -1;
+  acquiresleep(&swap.lock);
+  if(*pte & PTE_SWAP){
+    swaprw(PTE_ADDR(*pte) >> PGSHIFT, mem, 0);
+    swapfree(*pte);
+    *pte = V2P(mem) | (PTE_FLAGS(*pte) & ~PTE_SWAP) | PTE_P;
+    memacct(pgdir, 1, 0);
+    vmcount(pgdir, VM_SWAPIN);
+    mem = 0;
+  }
+  releasesleep(&swap.lock);
+  if(mem){
+    kfree(mem);
+    vmcount(pgdir, VM_PGFREE);
+  }
+  return 0;
+}
+
+// Make sure the user pages in [va, va+n) are in memory, so that
+// the kernel can use them without faulting, for instance while
+// it holds a spinlock.
+int
+swapinrange(pde_t *pgdir, uint va, uint n)
+{
+  pte_t *pte;
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE){
+    pte = walkpgdir(pgdir, (char*)a, 0);
+    if(pte && (*pte & PTE_SWAP) && swapin(pgdir, a) < 0)
+      return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,131 @@
+// Test of swapping user pages out to disk.
+//
+// A child grows until memory is full, stamps every page with its
+// own address, then spins in user mode.  The parent, pinned to the
+// same CPU so that the child is always preempted when the parent
+// runs, then grows by GROW bytes, which can only succeed if the
+// child's pages are swapped out.  Finally the child checks that
+// all of its pages came back intact.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+
+#define PAGE   4096
+#define CHUNK  (256 * PAGE)
+#define SLACK  (16 * PAGE)   // left free for page tables
+#define GROW   (512 * PAGE)
+#define TRIES  20
+
+char *gofile = "swaptest.go";
+int fds[2];
+
+static void
+fail(char *msg)
+{
+  printf(1, "swaptest: FAILED: %s\n", msg);
+  unlink(gofile);
+  exit();
+}
+
+// Stamp each page in [lo, hi) with its address.
+static void
+stamp(char *lo, char *hi)
+{
+  char *p;
+
+  for(p = lo; p < hi; p += PAGE)
+    *(char**)p = p;
+}
+
+// Return the number of pages in [lo, hi) whose stamp is wrong.
+static int
+check(char *lo, char *hi)
+{
+  char *p;
+  int bad;
+
+  bad = 0;
+  for(p = lo; p < hi; p += PAGE)
+    if(*(char**)p != p)
+      bad++;
+  return bad;
+}
+
+static void
+child(void)
+{
+  char *lo, *hi;
+  int fd, bad;
+  volatile int i;
+
+  lo = sbrk(0);
+  while(sbrk(CHUNK) != (char*)-1)
+    ;
+  while(sbrk(PAGE) != (char*)-1)
+    ;
+  sbrk(-SLACK);
+  hi = sbrk(0);
+  stamp(lo, hi);
+  printf(1, "swaptest: child holds %d pages\n", (hi - lo) / PAGE);
+  write(fds[1], "f", 1);
+
+  // Wait for the parent mostly in user mode, where the timer
+  // leaves it swappable.
+  for(;;){
+    for(i = 0; i < 1000000; i++)
+      ;
+    if((fd = open(gofile, O_RDONLY)) >= 0)
+      break;
+  }
+  close(fd);
+  bad = check(lo, hi);
+  write(fds[1], &bad, sizeof(bad));
+  exit();
+}
+
+int
+main(void)
+{
+  char *lo, c;
+  int pid, bad, n;
+
+  unlink(gofile);
+  if(pipe(fds) < 0)
+    fail("pipe");
+  setaffinity(getpid(), 1);
+  pid = fork();
+  if(pid < 0)
+    fail("fork");
+  if(pid == 0)
+    child();
+  if(read(fds[0], &c, 1) != 1)
+    fail("child died");
+
+  // The child may now and then be caught in the kernel, where
+  // its pages cannot be taken; give it a few chances.
+  lo = sbrk(0);
+  for(n = 0; n < TRIES && sbrk(GROW) == (char*)-1; n++)
+    sleep(1);
+  if(n == TRIES){
+    kill(pid);
+    wait();
+    fail("could not grow with memory full");
+  }
+  stamp(lo, lo + GROW);
+  if(check(lo, lo + GROW) != 0)
+    fail("parent's pages corrupted");
+  sbrk(-GROW);
+
+  close(open(gofile, O_CREATE|O_RDWR));
+  if(read(fds[0], &bad, sizeof(bad)) != sizeof(bad))
+    fail("child died");
+  wait();
+  unlink(gofile);
+  if(bad)
+    printf(1, "swaptest: FAILED: %d of the child's pages corrupted\n", bad);
+  else
+    printf(1, "swaptest: PASSED\n");
+  exit();
+}
@@ -6,6 +6,7 @@
 #include "proc.h"
 #include "x86.h"
 #include "syscall.h"
+#include "sysstat.h"
 
 // User code makes a system call with INT T_SYSCALL.
 // System call number in %eax.
@@ -13,13 +14,17 @@
 // library system call function. The saved user %esp points
 // to a saved program counter, and then the first argument.
 
+// Arguments may also lie in mmap() regions, above sz.  mmapfill()
+// checks those and reads in their pages first.
+
 // Fetch the int at addr from the current process.
 int
 fetchint(uint addr, int *ip)
 {
   struct proc *curproc = myproc();
 
-  if(addr >= curproc->sz || addr+4 > curproc->sz)
+  if((addr >= curproc->sz || addr+4 > curproc->sz) &&
+     mmapfill(curproc, addr, 4, 0) < 0)
     return -1;
   *ip = *(int*)(addr);
   return 0;
@@ -34,9 +39,17 @@ fetchstr(uint addr, char **pp)
   char *s, *ep;
   struct proc *curproc = myproc();
 
-  if(addr >= curproc->sz)
-    return -1;
   *pp = (char*)addr;
+  if(addr >= curproc->sz){
+    // In an mmap() region: read it in a page at a time.
+    for(s = *pp; ; s++){
+      if((s == *pp || (uint)s % PGSIZE == 0) &&
+         mmapfill(curproc, (uint)s, 1, 0) < 0)
+        return -1;
+      if(*s == 0)
+        return s - *pp;
+    }
+  }
   ep = (char*)curproc->sz;
   for(s = *pp; s < ep; s++){
     if(*s == 0)
@@ -52,6 +65,46 @@ argint(int n, int *ip)
   return fetchint((myproc()->tf->esp) + 4 + 4*n, ip);
 }
 
+// Check that the block of memory of size bytes at addr lies
+// within the current process's address space, and may be written
+// there if write is set, and set *pp to it.
+static int
+checkptr(uint addr, char **pp, int size, int write)
+{
+  struct proc *curproc = myproc();
+
+  if(size < 0)
+    return -1;
+  // The caller may use the block while holding a spinlock, when
+  // it cannot fault in pages that were swapped out, stack pages
+  // not yet used or pages of mmap()ed files not yet read.
+  if(addr >= curproc->sz || addr+size > curproc->sz){
+    if(mmapfill(curproc, addr, size, write) < 0)
+      return -1;
+  } else {
+    if(swapinrange(curproc->pgdir, addr, size) < 0)
+      return -1;
+    stackfill(curproc, addr, size);
+  }
+  *pp = (char*)addr;
+  return 0;
+}
+
+// Check a block of memory that the kernel may write to.
+int
+fetchptr(uint addr, char **pp, int size)
+{
+  return checkptr(addr, pp, size, 1);
+}
+
+// Check a block of memory that the kernel only reads, which may
+// therefore also lie in a read-only mapping.
+int
+fetchrdptr(uint addr, char **pp, int size)
+{
+  return checkptr(addr, pp, size, 0);
+}
+
 // Fetch the nth word-sized system call argument as a pointer
 // to a block of memory of size bytes.  Check that the pointer
 // lies within the process address space.
@@ -59,14 +112,21 @@ int
 argptr(int n, char **pp, int size)
 {
   int i;
-  struct proc *curproc = myproc();
 
   if(argint(n, &i) < 0)
     return -1;
-  if(size < 0 || (uint)i >= curproc->sz || (uint)i+size > curproc->sz)
+  return fetchptr((uint)i, pp, size);
+}
+
+// Like argptr(), for a block that the kernel only reads.
+int
+argrdptr(int n, char **pp, int size)
+{
+  int i;
+
+  if(argint(n, &i) < 0)
     return -1;
-  *pp = (char*)i;
-  return 0;
+  return fetchrdptr((uint)i, pp, size);
 }
 
 // Fetch the nth word-sized system call argument as a string pointer.
@@ -117,6 +177,34 @@ extern int sys_setuid(void);
 extern int sys_setgid(void);
 extern int sys_getprocs(void);
 #endif  //CS333_P2
+#ifdef CS333_P4
+extern int sys_setpriority(void);
+extern int sys_getpriority(void);
+#endif  //CS333_P4
+extern int sys_mmap(void);
+extern int sys_munmap(void);
+extern int sys_ioring_setup(void);
+extern int sys_ioring_enter(void);
+extern int sys_sysstats(void);
+extern int sys_kprof(void);
+#ifdef CS333_P4
+extern int sys_settickets(void);
+#endif // CS333_P4
+extern int sys_setaffinity(void);
+extern int sys_getaffinity(void);
+extern int sys_schedtrace(void);
+extern int sys_cpustats(void);
+#ifdef CS333_P2
+extern int sys_procquery(void);
+#endif // CS333_P2
+extern int sys_maxproc(void);
+#ifdef CS333_P4
+extern int sys_setprioritylist(void);
+extern int sys_setprioritygroup(void);
+#endif // CS333_P4
+extern int sys_getrlimit(void);
+extern int sys_setrlimit(void);
+extern int sys_getvmstat(void);
 
 static int (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -154,9 +242,36 @@ static int (*syscalls[])(void) = {
 [SYS_setgid]  sys_setgid,
 [SYS_getprocs]  sys_getprocs,
 #endif  //CS333_P2
+#ifdef CS333_P4
+[SYS_setpriority] sys_setpriority,
+[SYS_getpriority] sys_getpriority,
+#endif  //CS333_P4
+[SYS_mmap]    sys_mmap,
+[SYS_munmap]  sys_munmap,
+[SYS_ioring_setup] sys_ioring_setup,
+[SYS_ioring_enter] sys_ioring_enter,
+[SYS_sysstats] sys_sysstats,
+[SYS_kprof]   sys_kprof,
+#ifdef CS333_P4
+[SYS_settickets] sys_settickets,
+#endif // CS333_P4
+[SYS_setaffinity] sys_setaffinity,
+[SYS_getaffinity] sys_getaffinity,
+[SYS_schedtrace] sys_schedtrace,
+[SYS_cpustats] sys_cpustats,
+#ifdef CS333_P2
+[SYS_procquery] sys_procquery,
+#endif // CS333_P2
+[SYS_maxproc] sys_maxproc,
+#ifdef CS333_P4
+[SYS_setprioritylist] sys_setprioritylist,
+[SYS_setprioritygroup] sys_setprioritygroup,
+#endif // CS333_P4
+[SYS_getrlimit] sys_getrlimit,
+[SYS_setrlimit] sys_setrlimit,
+[SYS_getvmstat] sys_getvmstat,
 };
 
-#ifdef PRINT_SYSCALLS
 static char *syscallnames[] = {
   [SYS_fork]    "fork",
   [SYS_exit]    "exit",
@@ -193,24 +308,119 @@ static char *syscallnames[] = {
   [SYS_setgid]  "setgid",
   [SYS_getprocs]  "getprocs",
 #endif  //CS333_P2
+#ifdef CS333_P4
+  [SYS_setpriority] "setpriority",
+  [SYS_getpriority] "getpriority",
+#endif  //CS333_P4
+  [SYS_mmap]    "mmap",
+  [SYS_munmap]  "munmap",
+  [SYS_ioring_setup] "ioring_setup",
+  [SYS_ioring_enter] "ioring_enter",
+  [SYS_sysstats] "sysstats",
+  [SYS_kprof]   "kprof",
+#ifdef CS333_P4
+  [SYS_settickets] "settickets",
+#endif // CS333_P4
+  [SYS_setaffinity] "setaffinity",
+  [SYS_getaffinity] "getaffinity",
+  [SYS_schedtrace] "schedtrace",
+  [SYS_cpustats] "cpustats",
+#ifdef CS333_P2
+  [SYS_procquery] "procquery",
+#endif // CS333_P2
+  [SYS_maxproc] "maxproc",
+#ifdef CS333_P4
+  [SYS_setprioritylist] "setprioritylist",
+  [SYS_setprioritygroup] "setprioritygroup",
+#endif // CS333_P4
+  [SYS_getrlimit] "getrlimit",
+  [SYS_setrlimit] "setrlimit",
+  [SYS_getvmstat] "getvmstat",
 };
-#endif // PRINT_SYSCALLS
+
+// Per-CPU statistics, so that recording a call needs no lock.
+static struct sysstat sysstats[NCPU][NELEM(syscalls)];
+static int sysstatson;
+
+static void
+sysstatrecord(int num, uint64 cycles)
+{
+  struct sysstat *s;
+  int b;
+
+  for(b = 0; b < NSYSHIST-1; b++)
+    if((cycles >> (SYSHIST_SHIFT + b + 1)) == 0)
+      break;
+  pushcli();
+  s = &sysstats[cpuid()][num];
+  s->count++;
+  s->cycles += cycles;
+  s->hist[b]++;
+  popcli();
+}
 
 void
 syscall(void)
 {
   int num;
+  uint64 start;
   struct proc *curproc = myproc();
 
   num = curproc->tf->eax;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
-    curproc->tf->eax = syscalls[num]();
-#ifdef PRINT_SYSCALLS
-    cprintf("%s -> %d\n", syscallnames[num], curproc->tf->eax);
-#endif
+    if(sysstatson){
+      start = rdtsc();
+      curproc->tf->eax = syscalls[num]();
+      sysstatrecord(num, rdtsc() - start);
+    } else
+      curproc->tf->eax = syscalls[num]();
   } else {
     cprintf("%d %s: unknown sys call %d\n",
             curproc->pid, curproc->name, num);
     curproc->tf->eax = -1;
   }
 }
+
+// Control and read the per-system-call statistics.
+// sysstats(SYSSTAT_READ, buf, n) fills buf[0..n-1], summed over all
+// CPUs and indexed by system call number, and returns how many
+// entries it filled.  The other commands return 0.
+int
+sys_sysstats(void)
+{
+  int cmd, n, i, c, b;
+  struct sysstat *buf, *s;
+
+  if(argint(0, &cmd) < 0)
+    return -1;
+  switch(cmd){
+  case SYSSTAT_OFF:
+  case SYSSTAT_ON:
+    sysstatson = (cmd == SYSSTAT_ON);
+    return 0;
+  case SYSSTAT_RESET:
+    memset(sysstats, 0, sizeof(sysstats));
+    return 0;
+  case SYSSTAT_READ:
+    if(argint(2, &n) < 0 || n < 0)
+      return -1;
+    if(n > NELEM(syscalls))
+      n = NELEM(syscalls);
+    if(argptr(1, (void*)&buf, n*sizeof(*buf)) < 0)
+      return -1;
+    memset(buf, 0, n*sizeof(*buf));
+    for(i = 0; i < n; i++){
+      if(syscallnames[i])
+        safestrcpy(buf[i].name, syscallnames[i], sizeof(buf[i].name));
+      for(c = 0; c < ncpu; c++){
+        s = &sysstats[c][i];
+        buf[i].count += s->count;
+        buf[i].cycles += s->cycles;
+        for(b = 0; b < NSYSHIST; b++)
+          buf[i].hist[b] += s->hist[b];
+      }
+    }
+    return n;
+  }
+  return -1;
+}
@@ -29,3 +29,23 @@
 #define SYS_setuid  SYS_getppid+1
 #define SYS_setgid  SYS_setuid+1
 #define SYS_getprocs  SYS_setgid+1
+#define SYS_setpriority SYS_getprocs+1
+#define SYS_getpriority SYS_setpriority+1
+#define SYS_mmap    SYS_getpriority+1
+#define SYS_munmap  SYS_mmap+1
+#define SYS_ioring_setup SYS_munmap+1
+#define SYS_ioring_enter SYS_ioring_setup+1
+#define SYS_sysstats SYS_ioring_enter+1
+#define SYS_kprof   SYS_sysstats+1
+#define SYS_settickets SYS_kprof+1
+#define SYS_setaffinity SYS_settickets+1
+#define SYS_getaffinity SYS_setaffinity+1
+#define SYS_schedtrace SYS_getaffinity+1
+#define SYS_cpustats SYS_schedtrace+1
+#define SYS_procquery SYS_cpustats+1
+#define SYS_maxproc SYS_procquery+1
+#define SYS_setprioritylist SYS_maxproc+1
+#define SYS_setprioritygroup SYS_setprioritylist+1
+#define SYS_getrlimit SYS_setprioritygroup+1
+#define SYS_setrlimit SYS_getrlimit+1
+#define SYS_getvmstat SYS_setrlimit+1
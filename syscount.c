@@ -0,0 +1,108 @@
+// Show per-system-call counts and latencies collected by the kernel.
+//
+//   syscount on | off | reset   control collection
+//   syscount [-h]               print the busiest calls; -h adds
+//                               the latency histograms
+
+#include "types.h"
+#include "user.h"
+#include "x86.h"
+#include "sysstat.h"
+
+#define MAXSYS 64
+
+struct sysstat stats[MAXSYS];
+uint kpt;  // 1024-cycle units per clock tick
+
+// Estimate the TSC rate against the clock tick.
+static void
+calibrate(void)
+{
+  uint t0;
+  uint64 c0;
+
+  t0 = uptime();
+  while(uptime() == t0)
+    ;
+  t0 = uptime();
+  c0 = rdtsc();
+  while(uptime() < t0 + 10)
+    ;
+  kpt = (uint)((rdtsc() - c0) >> 10) / 10;
+  if(kpt == 0)
+    kpt = 1;
+}
+
+// Convert cycles to microseconds without 64-bit division.
+static uint
+tous(uint64 cycles)
+{
+  uint k = cycles >> 10;
+  uint uspt = 1000000 / TPS;
+
+  if(k < 0xffffffff / uspt)
+    return k * uspt / kpt;
+  return k / kpt * uspt;
+}
+
+static void
+printhist(struct sysstat *s)
+{
+  int b;
+
+  printf(1, "\t");
+  for(b = 0; b < NSYSHIST; b++)
+    if(s->hist[b])
+      printf(1, " <2^%d:%d", SYSHIST_SHIFT + b + 1, s->hist[b]);
+  printf(1, "\n");
+}
+
+static void
+report(int hist)
+{
+  int n, i, j, order[MAXSYS];
+  struct sysstat *s;
+
+  if((n = sysstats(SYSSTAT_READ, stats, MAXSYS)) < 0){
+    printf(2, "syscount: sysstats failed\n");
+    exit();
+  }
+  calibrate();
+
+  // Sort by total time, busiest first.
+  for(i = 0; i < n; i++){
+    for(j = i; j > 0 && stats[order[j-1]].cycles < stats[i].cycles; j--)
+      order[j] = order[j-1];
+    order[j] = i;
+  }
+
+  printf(1, "Name\t\tCount\tTotal(us)\tAvg(us)\n");
+  for(i = 0; i < n; i++){
+    s = &stats[order[i]];
+    if(s->count == 0)
+      continue;
+    printf(1, "%s\t", s->name);
+    if(strlen(s->name) < 8)
+      printf(1, "\t");
+    printf(1, "%d\t%d\t\t%d\n", s->count, tous(s->cycles),
+           tous(s->cycles) / s->count);
+    if(hist)
+      printhist(s);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  if(argc == 1 || (argc == 2 && strcmp(argv[1], "-h") == 0))
+    report(argc == 2);
+  else if(argc == 2 && strcmp(argv[1], "on") == 0)
+    sysstats(SYSSTAT_ON, 0, 0);
+  else if(argc == 2 && strcmp(argv[1], "off") == 0)
+    sysstats(SYSSTAT_OFF, 0, 0);
+  else if(argc == 2 && strcmp(argv[1], "reset") == 0)
+    sysstats(SYSSTAT_RESET, 0, 0);
+  else
+    printf(2, "usage: syscount [on | off | reset | -h]\n");
+  exit();
+}
@@ -15,6 +15,7 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "ioring.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -43,7 +44,7 @@ fdalloc(struct file *f)
   int fd;
   struct proc *curproc = myproc();
 
-  for(fd = 0; fd < NOFILE; fd++){
+  for(fd = 0; fd < NOFILE && fd < curproc->rlim[RLIMIT_NOFILE].cur; fd++){
     if(curproc->ofile[fd] == 0){
       curproc->ofile[fd] = f;
       return fd;
@@ -85,7 +86,7 @@ sys_write(void)
   int n;
   char *p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0)
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argrdptr(1, &p, n) < 0)
     return -1;
   return filewrite(f, p, n);
 }
@@ -283,17 +284,14 @@ create(char *path, short type, short major, short minor)
   return ip;
 }
 
-int
-sys_open(void)
+// Open path with mode omode and return a new file descriptor.
+static int
+openpath(char *path, int omode)
 {
-  char *path;
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
 
-  if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
-    return -1;
-
   begin_op();
 
   if(omode & O_CREATE){
@@ -333,6 +331,17 @@ sys_open(void)
   return fd;
 }
 
+int
+sys_open(void)
+{
+  char *path;
+  int omode;
+
+  if(argstr(0, &path) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return openpath(path, omode);
+}
+
 int
 sys_mkdir(void)
 {
@@ -443,3 +452,109 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+int
+sys_mmap(void)
+{
+  struct file *f;
+  int off, len, prot;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &off) < 0 ||
+     argint(2, &len) < 0 || argint(3, &prot) < 0)
+    return -1;
+  return mmap(f, off, len, prot);
+}
+
+int
+sys_munmap(void)
+{
+  int addr, len;
+
+  if(argint(0, &addr) < 0 || argint(1, &len) < 0)
+    return -1;
+  return munmap((uint)addr, len);
+}
+
+// Register the calling process's I/O ring.  A null ring
+// unregisters it.
+int
+sys_ioring_setup(void)
+{
+  struct ioring *r;
+
+  if(argint(0, (int*)&r) < 0)
+    return -1;
+  if(r){
+    if(argptr(0, (void*)&r, sizeof(*r)) < 0)
+      return -1;
+    r->sqhead = r->sqtail = 0;
+    r->cqhead = r->cqtail = 0;
+  }
+  myproc()->ioring = r;
+  return 0;
+}
+
+// Run one queued request.  Each one is checked the same way the
+// matching system call checks its arguments.
+static int
+ioring_op(struct iosqe *e)
+{
+  struct proc *curproc = myproc();
+  struct file *f;
+  char *p;
+
+  if(e->op == IORING_OPEN){
+    if(fetchstr(e->addr, &p) < 0)
+      return -1;
+    return openpath(p, e->flags);
+  }
+  if(e->fd < 0 || e->fd >= NOFILE || (f = curproc->ofile[e->fd]) == 0)
+    return -1;
+  switch(e->op){
+  case IORING_READ:
+    if(fetchptr(e->addr, &p, e->len) < 0)
+      return -1;
+    return fileread(f, p, e->len);
+  case IORING_WRITE:
+    if(fetchrdptr(e->addr, &p, e->len) < 0)
+      return -1;
+    return filewrite(f, p, e->len);
+  case IORING_CLOSE:
+    curproc->ofile[e->fd] = 0;
+    fileclose(f);
+    return 0;
+  }
+  return -1;
+}
+
+// Run up to n queued requests in submission order, stopping early
+// if the submission queue empties or the completion queue fills.
+// Returns the number of requests run.
+int
+sys_ioring_enter(void)
+{
+  struct proc *curproc = myproc();
+  struct ioring *r;
+  struct iosqe e;
+  int n, done;
+
+  if(argint(0, &n) < 0 || (r = curproc->ioring) == 0)
+    return -1;
+  // The ring may have been sbrk()ed away since it was registered.
+  if((uint)r + sizeof(*r) > curproc->sz)
+    return -1;
+
+  for(done = 0; done < n; ){
+    if(r->sqhead == r->sqtail || r->cqtail - r->cqhead >= IORING_SIZE)
+      break;
+    e = r->sq[r->sqhead % IORING_SIZE];
+    r->sqhead++;
+    r->cq[r->cqtail % IORING_SIZE].data = e.data;
+    r->cq[r->cqtail % IORING_SIZE].res = ioring_op(&e);
+    r->cqtail++;
+    done++;
+    if(curproc->killed)
+      break;
+  }
+  return done;
+}
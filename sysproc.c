@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "cpustat.h"
 #ifdef PDX_XV6
 #include "pdx-kernel.h"
 #endif // PDX_XV6
@@ -42,6 +43,106 @@ sys_kill(void)
   return kill(pid);
 }
 
+int
+sys_setaffinity(void)
+{
+  int pid, mask;
+
+  if(argint(0, &pid) < 0 || argint(1, &mask) < 0)
+    return -1;
+  return setaffinity(pid, mask);
+}
+
+int
+sys_getaffinity(void)
+{
+  int pid;
+
+  if(argint(0, &pid) < 0)
+    return -1;
+  return getaffinity(pid);
+}
+
+int
+sys_cpustats(void)
+{
+  struct sysload *s;
+
+  if(argptr(0, (void*)&s, sizeof(*s)) < 0)
+    return -1;
+  getcpustats(s);
+  return 0;
+}
+
+int
+sys_getvmstat(void)
+{
+  int pid;
+  struct vmstat *v;
+
+  if(argint(0, &pid) < 0 || argptr(1, (void*)&v, sizeof(*v)) < 0)
+    return -1;
+  return getvmstat(pid, v);
+}
+
+// Return the limit on processes, first setting it to n if n > 0.
+// The limit is system-wide, so only uid 0 may set it.
+int
+sys_maxproc(void)
+{
+  int n;
+
+  if(argint(0, &n) < 0)
+    return -1;
+#ifdef CS333_P2
+  if(n > 0 && myproc()->uid != 0)
+    return -1;
+#else
+  if(n > 0)
+    return -1;
+#endif  //CS333_P2
+  return maxproc(n);
+}
+
+// Copy resource limit r (an RLIMIT_ value) out to the user.
+int
+sys_getrlimit(void)
+{
+  int r;
+  struct rlimit *rl;
+
+  if(argint(0, &r) < 0 || argptr(1, (void*)&rl, sizeof(*rl)) < 0)
+    return -1;
+  if(r < 0 || r >= NRLIMIT)
+    return -1;
+  *rl = myproc()->rlim[r];
+  return 0;
+}
+
+// Set resource limit r.  The soft limit may not exceed the
+// hard one, and only root may raise the hard limit.
+int
+sys_setrlimit(void)
+{
+  int r;
+  struct rlimit *rl;
+  struct proc *p = myproc();
+
+  if(argint(0, &r) < 0 || argptr(1, (void*)&rl, sizeof(*rl)) < 0)
+    return -1;
+  if(r < 0 || r >= NRLIMIT || rl->cur > rl->max)
+    return -1;
+#ifdef CS333_P2
+  if(rl->max > p->rlim[r].max && p->uid != 0)
+    return -1;
+#else
+  if(rl->max > p->rlim[r].max)
+    return -1;
+#endif  //CS333_P2
+  p->rlim[r] = *rl;
+  return 0;
+}
+
 int
 sys_getpid(void)
 {
@@ -111,7 +212,8 @@ sys_date(void)
   if(argptr(0, (void*)&d, sizeof(struct rtcdate)) < 0)
     return -1;
 
-  cmostime(d);
+  // The timer interrupt owns the CMOS clock; use its copy.
+  vdsodate(d);
   return 0;
 }
 #endif
@@ -145,7 +247,7 @@ sys_setuid(void)
   if(argint(0, &uid) < 0)
     return -1;
   //The min and max values allowed for uid values.
-  if(uid < 0 || uid > 32767)
+  if(uid < 0 || uid > MAXUIDGID)
     return -1;
 
   uint uint_uid = (uint) uid;
@@ -159,7 +261,7 @@ sys_setgid(void)
   if(argint(0, &gid) < 0)
     return -1;
   //The min and max values allowed for gid values.
-  if(gid < 0 || gid > 32767)
+  if(gid < 0 || gid > MAXUIDGID)
     return -1;
 
   uint uint_gid = (uint) gid;
@@ -174,11 +276,30 @@ sys_getprocs(void)
   struct uproc * table;
   if(argint(0, &max) < 0)
     return -1;
+  // There are never more processes, and the size cannot wrap.
+  if(max > NPROCMAX)
+    max = NPROCMAX;
   if(argptr(1, (void*)&table, (sizeof(struct uproc)*max)) < 0)
     return -1;
 
   return get_procs(max, table);
 }
+
+int
+sys_procquery(void)
+{
+  struct procquery *q;
+  struct uproc *table;
+  int max;
+
+  if(argptr(0, (void*)&q, sizeof(*q)) < 0 || argint(2, &max) < 0)
+    return -1;
+  if(max > NPROCMAX)
+    max = NPROCMAX;
+  if(max < 0 || argptr(1, (void*)&table, sizeof(struct uproc)*max) < 0)
+    return -1;
+  return procquery(q, table, max);
+}
 #endif  //CS333_P2
 
 #ifdef CS333_P4
@@ -197,6 +318,34 @@ sys_setpriority(void)
   return set_priority(pid, prio);
 }
 
+int
+sys_setprioritylist(void)
+{
+  int *pids, n, prio;
+
+  if(argint(1, &n) < 0 || argint(2, &prio) < 0)
+    return -1;
+  if(n < 0 || n > NPROCMAX ||
+     argptr(0, (void*)&pids, n * sizeof(pids[0])) < 0)
+    return -1;
+  return set_priority_list(pids, n, prio);
+}
+
+// Set the priority of every process in a group.  xv6 has no process
+// groups or sessions, so in their place a group is all the processes
+// with one group id (see setgid()), checked the same way.
+int
+sys_setprioritygroup(void)
+{
+  int gid, prio;
+
+  if(argint(0, &gid) < 0 || argint(1, &prio) < 0)
+    return -1;
+  if(gid < 0 || gid > MAXUIDGID)
+    return -1;
+  return set_priority_group(gid, prio);
+}
+
 int
 sys_getpriority(void)
 {
@@ -210,4 +359,14 @@ sys_getpriority(void)
 
   return get_priority(pid);
 }
+
+int
+sys_settickets(void)
+{
+  int pid, tickets;
+
+  if(argint(0, &pid) < 0 || argint(1, &tickets) < 0)
+    return -1;
+  return set_tickets(pid, tickets);
+}
 #endif
@@ -0,0 +1,22 @@
+// Per-system-call statistics kept by syscall() (see syscall.c).
+// Visible to both user and kernel space.
+
+// Commands for sysstats()
+#define SYSSTAT_OFF    0   // stop collecting
+#define SYSSTAT_ON     1   // start collecting
+#define SYSSTAT_RESET  2   // zero all counters
+#define SYSSTAT_READ   3   // copy out counters, indexed by SYS_ number
+
+// Latency histogram: bucket 0 counts calls under
+// 2^(SYSHIST_SHIFT+1) cycles, bucket i > 0 counts calls in
+// [2^(SYSHIST_SHIFT+i), 2^(SYSHIST_SHIFT+i+1)), and the last
+// bucket also takes everything longer.
+#define NSYSHIST      20
+#define SYSHIST_SHIFT  8
+
+struct sysstat {
+  char name[16];         // system call name, empty if unused
+  uint count;            // completed calls
+  uint64 cycles;         // total cycles spent in those calls
+  uint hist[NSYSHIST];
+};
@@ -0,0 +1,155 @@
+// A top-like view of the system: load averages, per-CPU
+// utilization, context switch and interrupt rates and run-queue
+// depth, then the processes that used the most CPU over the
+// interval, from the same getprocs() table that ps displays.
+//
+//   top [-d seconds] [-n count]
+
+#ifdef CS333_P2
+
+#include "types.h"
+#include "user.h"
+#include "param.h"
+#include "uproc.h"
+#include "cpustat.h"
+
+#define MAX   64
+#define NSHOW 10  // processes listed per update
+
+struct uproc before[MAX], after[MAX];
+struct sysload l0, l1;
+
+// a*100/b, without 64-bit division.
+static uint
+percent(uint64 a, uint64 b)
+{
+  while(b >> 24){
+    a >>= 1;
+    b >>= 1;
+  }
+  if(b == 0)
+    return 0;
+  if(a > b)
+    return 100;
+  return (uint)a * 100 / (uint)b;
+}
+
+// A load average as a decimal with two places.
+static void
+output_load(uint load)
+{
+  uint frac = ((load & (FIXED_1 - 1)) * 100) >> FSHIFT;
+
+  printf(1, "%d.%s%d", load >> FSHIFT, frac < 10 ? "0" : "", frac);
+}
+
+static void
+display_cpus(uint ms)
+{
+  struct cpustat *c0, *c1;
+  int i;
+
+  printf(1, "load average: ");
+  for(i = 0; i < 3; i++){
+    output_load(l1.load[i]);
+    printf(1, i < 2 ? ", " : "");
+  }
+  printf(1, "   running: %d\n\n", l1.nrun);
+
+  printf(1, "CPU\tBusy\tCtxsw/s\tIntr/s\tReady\tPID\n");
+  for(i = 0; i < l1.ncpu; i++){
+    c0 = &l0.cpu[i];
+    c1 = &l1.cpu[i];
+    printf(1, "%d\t%d%%\t%d\t%d\t%d\t", i,
+           100 - percent(c1->idle - c0->idle, l1.tsc - l0.tsc),
+           (c1->nswitch - c0->nswitch) * 1000 / ms,
+           (c1->nintr - c0->nintr) * 1000 / ms, c1->nready);
+    if(c1->pid)
+      printf(1, "%d\n", c1->pid);
+    else
+      printf(1, "-\n");
+  }
+}
+
+// CPU time p used since the first snapshot, in microseconds.
+static uint
+cpu_delta(struct uproc *p, int nbefore)
+{
+  int i;
+
+  for(i = 0; i < nbefore; i++)
+    if(before[i].pid == p->pid)
+      return p->CPU_total_us - before[i].CPU_total_us;
+  return p->CPU_total_us;
+}
+
+static void
+display_procs(int nbefore, int nafter, uint ms)
+{
+  uint used[MAX];
+  int order[MAX];
+  int i, j;
+  struct uproc *p;
+
+  // Sort by CPU time used over the interval, busiest first.
+  for(i = 0; i < nafter; i++){
+    used[i] = cpu_delta(&after[i], nbefore);
+    for(j = i; j > 0 && used[order[j-1]] < used[i]; j--)
+      order[j] = order[j-1];
+    order[j] = i;
+  }
+
+  printf(1, "\nPID\tName\t\tUID\tCPU%%\tState\tSize\tCPUs\n");
+  for(i = 0; i < nafter && i < NSHOW; i++){
+    p = &after[order[i]];
+    printf(1, "%d\t%s\t", p->pid, p->name);
+    if(strlen(p->name) < 9)
+      printf(1, "\t");
+    printf(1, "%d\t%d%%\t%s\t%d\t%x\n", p->uid, used[order[i]] / (ms * 10),
+           p->state, p->size, p->affinity);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nbefore, nafter, delay, count, i;
+  uint t0, ms;
+
+  delay = 1;
+  count = 1;
+  for(i = 1; i + 1 < argc; i += 2){
+    if(strcmp(argv[i], "-d") == 0)
+      delay = atoi(argv[i+1]);
+    else if(strcmp(argv[i], "-n") == 0)
+      count = atoi(argv[i+1]);
+    else
+      break;
+  }
+  if(i != argc || delay <= 0 || count <= 0){
+    printf(2, "usage: top [-d seconds] [-n count]\n");
+    exit();
+  }
+
+  while(count-- > 0){
+    t0 = uptime();
+    nbefore = getprocs(MAX, before);
+    if(nbefore < 0 || cpustats(&l0) < 0){
+      printf(2, "top: cannot read statistics\n");
+      exit();
+    }
+    sleep(delay * TPS);
+    nafter = getprocs(MAX, after);
+    cpustats(&l1);
+    ms = (uptime() - t0) * 1000 / TPS;
+    if(ms == 0)
+      ms = 1;
+
+    display_cpus(ms);
+    display_procs(nbefore, nafter, ms);
+    if(count)
+      printf(1, "\n");
+  }
+  exit();
+}
+#endif  //CS333_P2
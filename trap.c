@@ -28,6 +28,9 @@ tvinit(void)
   for(i = 0; i < 256; i++)
     SETGATE(idt[i], 0, SEG_KCODE<<3, vectors[i], 0);
   SETGATE(idt[T_SYSCALL], 1, SEG_KCODE<<3, vectors[T_SYSCALL], DPL_USER);
+  // Double faults switch to the task seginit() set up.
+  SETGATE(idt[T_DBLFLT], 0, SEG_DFTSS<<3, 0, 0);
+  idt[T_DBLFLT].type = STS_TG;
 
 #ifndef PDX_XV6
   initlock(&tickslock, "time");
@@ -40,20 +43,37 @@ idtinit(void)
   lidt(idt, sizeof(idt));
 }
 
-//PAGEBREAK: 41
+// Give each CPU a stack of its own to take device interrupts on.
 void
-trap(struct trapframe *tf)
+istackinit(void)
 {
-  if(tf->trapno == T_SYSCALL){
-    if(myproc()->killed)
-      exit();
-    myproc()->tf = tf;
-    syscall();
-    if(myproc()->killed)
-      exit();
-    return;
-  }
+  struct cpu *c;
 
+  for(c = cpus; c < cpus+ncpu; c++)
+    if((c->intrstack = kstackalloc()) == 0)
+      panic("istackinit");
+}
+
+// Entered by a task switch on a double fault, on a stack of its
+// own.  The state of whatever faulted was saved in mycpu()->ts.
+void
+dblfault(void)
+{
+  struct taskstate *ts = &mycpu()->ts;
+
+  cprintf("cpu%d: double fault at eip 0x%x esp 0x%x\n",
+          cpuid(), ts->eip, ts->esp);
+  if((uint)ts->esp >= KSTACKBASE && (uint)ts->esp < DEVSPACE)
+    panic("kernel stack overflow");
+  panic("double fault");
+}
+
+// Handle a device interrupt.  Runs on the CPU's interrupt stack,
+// with interrupts off, so it never nests.  Returns 0 if tf is not
+// a device interrupt after all.
+static int
+devintr(struct trapframe *tf)
+{
   switch(tf->trapno){
   case T_IRQ0 + IRQ_TIMER:
     if(cpuid() == 0){
@@ -66,7 +86,14 @@ trap(struct trapframe *tf)
       wakeup(&ticks);
       release(&tickslock);
 #endif // PDX_XV6
+      vdsotick();
+      calcload();
     }
+    kprofsample(tf);
+#ifdef CS333_P2
+    if(myproc() && myproc()->state == RUNNING)
+      cpulimit();
+#endif  //CS333_P2
     lapiceoi();
     break;
   case T_IRQ0 + IRQ_IDE:
@@ -90,9 +117,64 @@ trap(struct trapframe *tf)
             cpuid(), tf->cs, tf->eip);
     lapiceoi();
     break;
+  default:
+    return 0;
+  }
+  return 1;
+}
+
+//PAGEBREAK: 41
+void
+trap(struct trapframe *tf)
+{
+  if(tf->trapno == T_SYSCALL){
+    if(myproc()->killed)
+      exit();
+    myproc()->tf = tf;
+    syscall();
+    if(myproc()->killed)
+      exit();
+    return;
+  }
+
+  if(tf->trapno >= T_IRQ0)
+    mycpu()->nintr++;
+
+  switch(tf->trapno){
+  case T_PGFLT:
+    // Pages that were swapped out are read back in, whether the
+    // process or the kernel on its behalf touched them, so long as
+    // the kernel holds no spinlock.
+    if(myproc() && rcr2() < KERNBASE &&
+       ((tf->cs&3) == DPL_USER || mycpu()->ncli == 0) &&
+       swapin(myproc()->pgdir, PGROUNDDOWN(rcr2())) == 0){
+      vmcount(myproc()->pgdir, VM_FAULT);
+      vmcount(myproc()->pgdir, VM_MAJFAULT);
+      break;
+    }
+    // The user stack grows a page at a time as it is used.
+    if(myproc() && ((tf->cs&3) == DPL_USER || mycpu()->ncli == 0) &&
+       stackfault(myproc(), rcr2()) == 0){
+      vmcount(myproc()->pgdir, VM_FAULT);
+      break;
+    }
+    // Pages of mmap()ed files are read in on first touch.
+    if(myproc() && (tf->cs&3) == DPL_USER &&
+       mmapfault(myproc(), rcr2(), tf->err) == 0){
+      vmcount(myproc()->pgdir, VM_FAULT);
+      vmcount(myproc()->pgdir, VM_MAJFAULT);
+      break;
+    }
+    // Otherwise it is an ordinary bad access.
+    // fall through
 
   //PAGEBREAK: 13
   default:
+    // Device interrupts run on the CPU's interrupt stack, so they
+    // do not add to the depth of the kernel stack they interrupted.
+    if(tf->trapno >= T_IRQ0 &&
+       callonstack(devintr, tf, mycpu()->intrstack + KSTACKSIZE))
+      break;
     if(myproc() == 0 || (tf->cs&3) == 0){
       // In kernel, it must be our mistake.
       cprintf("unexpected trap %d from cpu %d eip %x (cr2=0x%x)\n",
@@ -121,7 +203,13 @@ trap(struct trapframe *tf)
 #else
     tf->trapno == T_IRQ0+IRQ_TIMER)
 #endif // PDX_XV6
+  {
+    // Its memory may be swapped out while it waits, since it has
+    // no TLB entries anywhere and cannot touch it until it runs.
+    myproc()->swapok = (tf->cs&3) == DPL_USER;
     yield();
+    myproc()->swapok = 0;
+  }
 
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
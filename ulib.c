@@ -3,6 +3,8 @@
 #include "fcntl.h"
 #include "user.h"
 #include "x86.h"
+#include "date.h"
+#include "vdso.h"
 
 char*
 strcpy(char *s, char *t)
@@ -145,3 +147,55 @@ memmove(void *vdst, void *vsrc, int n)
     *dst++ = *src++;
   return vdst;
 }
+
+// These read the pages the kernel maps at VDSO_SHARED and
+// VDSO_PROC instead of trapping into the kernel.
+int
+getpid(void)
+{
+  return ((struct vdso_proc*)VDSO_PROC)->pid;
+}
+
+int
+uptime(void)
+{
+  return ((volatile struct vdso_shared*)VDSO_SHARED)->ticks;
+}
+
+#ifdef CS333_P1
+// The kernel rewrites the date once a second; retry if it did so
+// while we were copying.
+int
+date(struct rtcdate *r)
+{
+  volatile struct vdso_shared *v = (struct vdso_shared*)VDSO_SHARED;
+  uint seq;
+
+  do {
+    while((seq = v->seq) & 1)
+      ;
+    *r = v->date;
+  } while(v->seq != seq);
+  return 0;
+}
+#endif // CS333_P1
+
+#ifdef CS333_P2
+uint
+getuid(void)
+{
+  return ((struct vdso_proc*)VDSO_PROC)->uid;
+}
+
+uint
+getgid(void)
+{
+  return ((struct vdso_proc*)VDSO_PROC)->gid;
+}
+
+uint
+getppid(void)
+{
+  return ((struct vdso_proc*)VDSO_PROC)->ppid;
+}
+#endif // CS333_P2
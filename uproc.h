@@ -10,8 +10,27 @@ struct uproc {
 #endif // CS333_P4
   uint elapsed_ticks;
   uint CPU_total_ticks;
+  uint CPU_total_us;     // CPU_total_ticks to the microsecond
   char state[STRMAX];
   uint size;
+  uint rss;              // bytes of user memory resident
+  uint ptpages;          // page table pages
+  uint kmem;             // bytes of kernel memory held for it
+  uint affinity;         // CPUs it may run on, bit i for CPU i
   char name[STRMAX];
 };
 
+
+// Selects processes for procquery().  Zero fields match
+// everything, except uid, where that is -1.
+struct procquery {
+  uint start;            // slot to resume the scan at; 0 to begin
+  uint states;           // PQ_ bits of the states wanted
+  int uid;               // only this user's processes
+  uint minpid, maxpid;   // only pids in [minpid, maxpid]
+};
+
+#define PQ_SLEEPING  (1 << 2)
+#define PQ_RUNNABLE  (1 << 3)
+#define PQ_RUNNING   (1 << 4)
+#define PQ_ZOMBIE    (1 << 5)
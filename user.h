@@ -1,6 +1,14 @@
 struct stat;
 struct rtcdate;
 struct uproc;
+struct procquery;
+struct ioring;
+struct sysstat;
+struct kprofsample;
+struct schedevent;
+struct sysload;
+struct rlimit;
+struct vmstat;
 
 // system calls
 int fork(void);
@@ -25,9 +33,39 @@ char* sbrk(int);
 int sleep(int);
 int uptime(void);
 int halt(void);
+void* mmap(int fd, int off, int len, int prot);
+int munmap(void* addr, int len);
+int ioring_setup(struct ioring*);
+int ioring_enter(int);
+int sysstats(int, struct sysstat*, int);
+int kprof(int, struct kprofsample*, int);
+int setaffinity(int pid, uint mask);
+int getaffinity(int pid);
+int schedtrace(int, struct schedevent*, int);
+int cpustats(struct sysload*);
+int maxproc(int);
+int getrlimit(int, struct rlimit*);
+int setrlimit(int, struct rlimit*);
+int getvmstat(int pid, struct vmstat*);
 #ifdef CS333_P1
 int date(struct rtcdate*);
 #endif // CS333_P1
+#ifdef CS333_P2
+uint getuid(void);
+uint getgid(void);
+uint getppid(void);
+int setuid(uint);
+int setgid(uint);
+int getprocs(uint max, struct uproc* table);
+int procquery(struct procquery*, struct uproc*, int);
+#endif // CS333_P2
+#ifdef CS333_P4
+int setpriority(int pid, int priority);
+int getpriority(int pid);
+int settickets(int pid, int tickets);
+int setprioritylist(int *pids, int n, int priority);
+int setprioritygroup(int gid, int priority);
+#endif // CS333_P4
 
 // ulib.c
 int stat(char*, struct stat*);
@@ -0,0 +1,97 @@
+//
+// Kernel side of the vdso pages (see vdso.h).  The shared page
+// holds ticks and the wall-clock time and is kept current by the
+// timer interrupt on CPU 0, which is also the only place that
+// reads the CMOS clock.  Each process has its own identity page.
+// Both are mapped read-only at the top of user memory.
+//
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "proc.h"
+#include "date.h"
+#include "vdso.h"
+
+#ifndef TPS
+#define TPS 100
+#endif
+
+static volatile struct vdso_shared *vdso;
+
+void
+vdsoinit(void)
+{
+  struct rtcdate d;
+
+  if((vdso = (struct vdso_shared*)kalloc()) == 0)
+    panic("vdsoinit");
+  memset((void*)vdso, 0, PGSIZE);
+  cmostime(&d);
+  vdso->date = d;
+}
+
+// Called by the timer interrupt on CPU 0 after ticks advances.
+void
+vdsotick(void)
+{
+  struct rtcdate d;
+
+  vdso->ticks = ticks;
+  if(ticks % TPS != 0)
+    return;
+  cmostime(&d);
+  vdso->seq++;
+  vdso->date = d;
+  vdso->seq++;
+}
+
+// Copy out the wall-clock time, retrying if the timer
+// interrupt rewrote it while we were copying.
+void
+vdsodate(struct rtcdate *r)
+{
+  uint seq;
+
+  do {
+    while((seq = vdso->seq) & 1)
+      ;
+    *r = vdso->date;
+  } while(vdso->seq != seq);
+}
+
+// Bring p's identity page up to date.
+void
+vdsosetproc(struct proc *p)
+{
+  struct vdso_proc *v = (struct vdso_proc*)p->vdso;
+
+  if(v == 0)
+    return;
+  v->pid = p->pid;
+  v->ppid = p->parent ? p->parent->pid : p->pid;
+#ifdef CS333_P2
+  v->uid = p->uid;
+  v->gid = p->gid;
+#endif  //CS333_P2
+}
+
+// Map the shared page and p's identity page, allocating the
+// latter if p does not have one yet, into pgdir.
+int
+vdsomap(pde_t *pgdir, struct proc *p)
+{
+  if(p->vdso == 0){
+    if((p->vdso = kalloc()) == 0)
+      return -1;
+    memset(p->vdso, 0, PGSIZE);
+  }
+  vdsosetproc(p);
+  if(mappages(pgdir, (char*)VDSO_SHARED, PGSIZE, V2P(vdso), PTE_U) < 0)
+    return -1;
+  if(mappages(pgdir, (char*)VDSO_PROC, PGSIZE, V2P(p->vdso), PTE_U) < 0)
+    return -1;
+  return 0;
+}
@@ -0,0 +1,22 @@
+// Read-only pages the kernel maps into every process so that user
+// code can read the time and its own identity without a system call.
+// Visible to both user and kernel space; user code must include
+// date.h first.
+
+#define VDSO_SHARED 0x7FFFE000             // struct vdso_shared
+#define VDSO_PROC   (VDSO_SHARED + 0x1000) // struct vdso_proc
+
+// One page shared by all processes, updated by the timer interrupt.
+struct vdso_shared {
+  uint ticks;            // copy of the kernel's ticks
+  uint seq;              // odd while date is being rewritten
+  struct rtcdate date;   // wall-clock time, refreshed every second
+};
+
+// One page per process, rewritten when any field changes.
+struct vdso_proc {
+  uint pid;
+  uint ppid;             // own pid if there is no parent
+  uint uid;
+  uint gid;
+};
@@ -5,17 +5,24 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "spinlock.h"
 #include "elf.h"
+#include "date.h"
+#include "vdso.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
 
+// Stacks for the double fault task, see seginit().
+static char dfstack[NCPU][2048];
+
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
 void
 seginit(void)
 {
   struct cpu *c;
+  struct taskstate *ts;
 
   // Map "logical" addresses to virtual addresses using identity map.
   // Cannot share a CODE descriptor for both kernel and user
@@ -26,13 +33,27 @@ seginit(void)
   c->gdt[SEG_KDATA] = SEG(STA_W, 0, 0xffffffff, 0);
   c->gdt[SEG_UCODE] = SEG(STA_X|STA_R, 0, 0xffffffff, DPL_USER);
   c->gdt[SEG_UDATA] = SEG(STA_W, 0, 0xffffffff, DPL_USER);
+
+  // A fault while pushing a trap frame, as when a kernel stack
+  // runs into its guard page, becomes a double fault.  It needs
+  // a good stack of its own, so it switches tasks to dblfault().
+  ts = &c->dfts;
+  ts->cr3 = (void*)V2P(kpgdir);
+  ts->eip = (uint*)dblfault;
+  ts->eflags = 0x2;  // reserved bit; interrupts off
+  ts->esp = (uint*)(dfstack[c - cpus] + sizeof(dfstack[0]));
+  ts->cs = SEG_KCODE << 3;
+  ts->ds = ts->es = ts->ss = SEG_KDATA << 3;
+  ts->iomb = (ushort) 0xFFFF;
+  c->gdt[SEG_DFTSS] = SEG16(STS_T32A, ts, sizeof(*ts)-1, 0);
+  c->gdt[SEG_DFTSS].s = 0;
   lgdt(c->gdt, sizeof(c->gdt));
 }
 
 // Return the address of the PTE in page table pgdir
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page table pages.
-static pte_t *
+pte_t *
 walkpgdir(pde_t *pgdir, const void *va, int alloc)
 {
   pde_t *pde;
@@ -42,14 +63,18 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
   if(*pde & PTE_P){
     pgtab = (pte_t*)P2V(PTE_ADDR(*pde));
   } else {
-    if(!alloc || (pgtab = (pte_t*)kalloc()) == 0)
+    // kzalloc makes sure all those PTE_P bits are zero.
+    if(!alloc || (pgtab = (pte_t*)kzalloc()) == 0)
       return 0;
-    // Make sure all those PTE_P bits are zero.
-    memset(pgtab, 0, PGSIZE);
     // The permissions here are overly generous, but they can
     // be further restricted by the permissions in the page table
     // entries, if necessary.
     *pde = V2P(pgtab) | PTE_P | PTE_W | PTE_U;
+    // kvmalloc() runs before there are CPUs to count against.
+    if(pgdir != kpgdir){
+      memacct(pgdir, 0, 1);
+      vmcount(pgdir, VM_PTALLOC);
+    }
   }
   return &pgtab[PTX(va)];
 }
@@ -57,7 +82,7 @@ walkpgdir(pde_t *pgdir, const void *va, int alloc)
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa. va and size might not
 // be page-aligned.
-static int
+int
 mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
 {
   char *a, *last;
@@ -85,6 +110,12 @@ mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
 // page protection bits prevent user code from using the kernel's
 // mappings.
 //
+// kvmalloc() builds the kernel's mappings once, in kpgdir, and
+// setupkvm() shares them with every other page table by copying
+// kpgdir's directory entries for KERNBASE and up.  They use 4MB
+// PTE_PS pages wherever the alignment allows, and are PTE_G, so
+// that switching page tables does not flush them from the TLB.
+//
 // setupkvm() and exec() set up every page table like this:
 //
 //   0..KERNBASE: user memory (text+data+stack+heap), mapped to
@@ -114,33 +145,160 @@ static struct kmap {
  { (void*)DEVSPACE, DEVSPACE,      0,         PTE_W}, // more devices
 };
 
+// Map size bytes of kernel memory at va to pa, with a single
+// PTE_PS directory entry for each 4MB that is aligned in both.
+// size can wrap va around to 0.
+static int
+mapkvm(pde_t *pgdir, uint va, uint size, uint pa, int perm)
+{
+  uint end = va + size;
+
+  while(va != end){
+    if(va % SUPERPGSIZE == 0 && pa % SUPERPGSIZE == 0 &&
+       end - va >= SUPERPGSIZE){
+      pgdir[PDX(va)] = pa | perm | PTE_P | PTE_PS | PTE_G;
+      va += SUPERPGSIZE;
+      pa += SUPERPGSIZE;
+    } else {
+      if(mappages(pgdir, (void*)va, PGSIZE, pa, perm | PTE_G) < 0)
+        return -1;
+      va += PGSIZE;
+      pa += PGSIZE;
+    }
+  }
+  return 0;
+}
+
 // Set up kernel part of a page table.
 pde_t*
 setupkvm(void)
 {
   pde_t *pgdir;
-  struct kmap *k;
 
-  if((pgdir = (pde_t*)kalloc()) == 0)
+  if((pgdir = (pde_t*)kzalloc()) == 0)
     return 0;
-  memset(pgdir, 0, PGSIZE);
-  if (P2V(PHYSTOP) > (void*)DEVSPACE)
-    panic("PHYSTOP too high");
-  for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
-    if(mappages(pgdir, k->virt, k->phys_end - k->phys_start,
-                (uint)k->phys_start, k->perm) < 0) {
-      freevm(pgdir);
+  memmove(&pgdir[PDX(KERNBASE)], &kpgdir[PDX(KERNBASE)],
+          (NPDENTRIES - PDX(KERNBASE)) * sizeof(pde_t));
+  return pgdir;
+}
+
+// Kernel stacks live above the direct map, from KSTACKBASE, in
+// slots of KSTACKSIZE bytes with an unmapped guard page below each,
+// so that running off the end of one faults instead of writing
+// over whatever page is below.  Their page tables are made once,
+// by kstackinit(), and are shared by every page table, so a stack
+// mapped in kpgdir is mapped everywhere.
+//
+// The PTEs are not global, and freeing a stack does not flush other
+// CPUs' TLBs.  That is safe because a CPU only touches a stack that
+// is not its current process's in allocproc(), and kstackalloc()
+// flushes the new stack's pages on the CPU allocating it, and
+// because switchuvm() reloads %cr3 before a CPU runs on a process's
+// stack.
+#define KSLOT   (PGSIZE + KSTACKSIZE)
+#define NKSTACK (NPROCMAX + NCPU)  // a stack per process, and per CPU
+
+static struct {
+  struct spinlock lock;
+  int hand;                        // where to look for a free slot
+  char used[NKSTACK];
+} kstacks;
+
+static void
+kstackinit(void)
+{
+  uint va;
+
+  if(KSTACKBASE + NKSTACK*KSLOT > DEVSPACE)
+    panic("kstackinit: too many stacks");
+  initlock(&kstacks.lock, "kstacks");
+  for(va = KSTACKBASE; va < KSTACKBASE + NKSTACK*KSLOT; va += SUPERPGSIZE)
+    if(walkpgdir(kpgdir, (char*)va, 1) == 0)
+      panic("kstackinit");
+}
+
+// Unmap and free the first n bytes of the kernel stack at stack.
+static void
+kstackunmap(char *stack, uint n)
+{
+  pte_t *pte;
+  uint a;
+
+  for(a = 0; a < n; a += PGSIZE){
+    pte = walkpgdir(kpgdir, stack + a, 0);
+    kfree(P2V(PTE_ADDR(*pte)));
+    *pte = 0;
+    invlpg(stack + a);
+  }
+}
+
+// Allocate a kernel stack.  Returns its lowest address, or 0 if
+// out of memory.
+char*
+kstackalloc(void)
+{
+  char *stack, *mem;
+  int i, n;
+
+  acquire(&kstacks.lock);
+  for(n = 0; n < NKSTACK; n++){
+    i = kstacks.hand;
+    kstacks.hand = (i + 1) % NKSTACK;
+    if(!kstacks.used[i])
+      break;
+  }
+  if(n == NKSTACK){
+    release(&kstacks.lock);
+    return 0;
+  }
+  kstacks.used[i] = 1;
+  release(&kstacks.lock);
+
+  stack = (char*)KSTACKBASE + i*KSLOT + PGSIZE;
+  for(n = 0; n < KSTACKSIZE; n += PGSIZE){
+    if((mem = kalloc()) == 0 ||
+       mappages(kpgdir, stack + n, PGSIZE, V2P(mem), PTE_W) < 0){
+      if(mem)
+        kfree(mem);
+      kstackunmap(stack, n);
+      acquire(&kstacks.lock);
+      kstacks.used[i] = 0;
+      release(&kstacks.lock);
       return 0;
     }
-  return pgdir;
+    invlpg(stack + n);
+  }
+  return stack;
+}
+
+// Free a stack from kstackalloc().
+void
+kstackfree(char *stack)
+{
+  kstackunmap(stack, KSTACKSIZE);
+  acquire(&kstacks.lock);
+  kstacks.used[((uint)stack - KSTACKBASE) / KSLOT] = 0;
+  release(&kstacks.lock);
 }
 
 // Allocate one page table for the machine for the kernel address
-// space for scheduler processes.
+// space for scheduler processes.  Its kernel half is shared by
+// every other page table.
 void
 kvmalloc(void)
 {
-  kpgdir = setupkvm();
+  struct kmap *k;
+
+  if((kpgdir = (pde_t*)kalloc()) == 0)
+    panic("kvmalloc");
+  memset(kpgdir, 0, PGSIZE);
+  if (P2V(PHYSTOP) > (void*)DEVSPACE)
+    panic("PHYSTOP too high");
+  for(k = kmap; k < &kmap[NELEM(kmap)]; k++)
+    if(mapkvm(kpgdir, (uint)k->virt, k->phys_end - k->phys_start,
+              (uint)k->phys_start, k->perm) < 0)
+      panic("kvmalloc");
+  kstackinit();
   switchkvm();
 }
 
@@ -174,6 +332,7 @@ switchuvm(struct proc *p)
   mycpu()->ts.iomb = (ushort) 0xFFFF;
   ltr(SEG_TSS << 3);
   lcr3(V2P(p->pgdir));  // switch to process's address space
+  vmcount(p->pgdir, VM_TLBFLUSH);
   popcli();
 }
 
@@ -186,8 +345,7 @@ inituvm(pde_t *pgdir, char *init, uint sz)
 
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
-  mem = kalloc();
-  memset(mem, 0, PGSIZE);
+  mem = kzalloc();
   mappages(pgdir, 0, PGSIZE, V2P(mem), PTE_W|PTE_U);
   memmove(mem, init, sz);
 }
@@ -231,19 +389,20 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
 
   a = PGROUNDUP(oldsz);
   for(; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    mem = pagealloc(pgdir, 1);
     if(mem == 0){
       cprintf("allocuvm out of memory\n");
       deallocuvm(pgdir, newsz, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pgdir, (char*)a, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
       cprintf("allocuvm out of memory (2)\n");
       deallocuvm(pgdir, newsz, oldsz);
       kfree(mem);
+      vmcount(pgdir, VM_PGFREE);
       return 0;
     }
+    memacct(pgdir, 1, 0);
   }
   return newsz;
 }
@@ -273,13 +432,18 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
       char *v = P2V(pa);
       kfree(v);
       *pte = 0;
+      memacct(pgdir, -1, 0);
+      vmcount(pgdir, VM_PGFREE);
+    } else if(*pte & PTE_SWAP){
+      swapfree(*pte);
+      *pte = 0;
     }
   }
   return newsz;
 }
 
 // Free a page table and all the physical memory pages
-// in the user part.
+// in the user part.  The kernel part belongs to kpgdir.
 void
 freevm(pde_t *pgdir)
 {
@@ -287,11 +451,13 @@ freevm(pde_t *pgdir)
 
   if(pgdir == 0)
     panic("freevm: no pgdir");
-  deallocuvm(pgdir, KERNBASE, 0);
-  for(i = 0; i < NPDENTRIES; i++){
+  // The vdso pages at the top are not the process's to free.
+  deallocuvm(pgdir, VDSO_SHARED, 0);
+  for(i = 0; i < PDX(KERNBASE); i++){
     if(pgdir[i] & PTE_P){
       char * v = P2V(PTE_ADDR(pgdir[i]));
       kfree(v);
+      vmcount(pgdir, VM_PTFREE);
     }
   }
   kfree((char*)pgdir);
@@ -323,14 +489,21 @@ copyuvm(pde_t *pgdir, uint sz)
   if((d = setupkvm()) == 0)
     return 0;
   for(i = 0; i < sz; i += PGSIZE){
-    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0)
-      panic("copyuvm: pte should exist");
+    // Stack pages that were never touched are not there to copy.
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    if(*pte == 0)
+      continue;
+    if((*pte & PTE_SWAP) && swapin(pgdir, i) < 0)
+      goto bad;
     if(!(*pte & PTE_P))
       panic("copyuvm: page not present");
+    if((mem = pagealloc(d, 0)) == 0)
+      goto bad;
     pa = PTE_ADDR(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto bad;
     memmove(mem, (char*)P2V(pa), PGSIZE);
     if(mappages(d, (void*)i, PGSIZE, V2P(mem), flags) < 0)
       goto bad;
@@ -342,6 +515,145 @@ bad:
   return 0;
 }
 
+// Copy the pages of pgdir that are present or swapped out in
+// [start, end) into d.  Unlike copyuvm, pages that were never
+// touched are skipped, which suits lazily filled regions such as
+// mmap()ed files.
+int
+copyuvmrange(pde_t *d, pde_t *pgdir, uint start, uint end)
+{
+  pte_t *pte;
+  uint pa, i;
+  char *mem;
+
+  for(i = start; i < end; i += PGSIZE){
+    if((pte = walkpgdir(pgdir, (void *) i, 0)) == 0){
+      i = PGADDR(PDX(i) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    if((*pte & PTE_SWAP) && swapin(pgdir, i) < 0)
+      return -1;
+    if(!(*pte & PTE_P))
+      continue;
+    if((mem = pagealloc(d, 0)) == 0)
+      return -1;
+    pa = PTE_ADDR(*pte);
+    memmove(mem, (char*)P2V(pa), PGSIZE);
+    if(mappages(d, (void*)i, PGSIZE, V2P(mem), PTE_FLAGS(*pte)) < 0){
+      kfree(mem);
+      vmcount(d, VM_PGFREE);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// Charge pages user pages and ptpages page table pages, either of
+// which may be negative, to the current process if pgdir is its
+// page table.  Page tables under construction by fork() and exec()
+// belong to no one yet; vmusage() counts them once they are in use.
+void
+memacct(pde_t *pgdir, int pages, int ptpages)
+{
+  struct proc *p;
+
+  if((p = myproc()) == 0 || p->pgdir != pgdir)
+    return;
+  p->rss += pages;
+  p->ptpages += ptpages;
+}
+
+// The bytes of user memory that p would have with size sz and its
+// stack used down to low, which count against RLIMIT_MEM: all of sz
+// but the part of the stack region below low.
+uint
+memuse(struct proc *p, uint sz, uint low)
+{
+  return sz - (low - p->stackbot);
+}
+
+// Give the user stack of p a zeroed page at va, if va lies in the
+// stack region exec() set aside, within RLIMIT_STACK of its top and
+// below p->sz, has no page yet, and RLIMIT_MEM allows it.
+// Returns 0 if it did, or -1.
+int
+stackfault(struct proc *p, uint va)
+{
+  pte_t *pte;
+  char *mem;
+
+  if(va < p->stackbot || va >= p->stacktop || va >= p->sz ||
+     p->stacktop - va > p->rlim[RLIMIT_STACK].cur)
+    return -1;
+  va = PGROUNDDOWN(va);
+  if(va < p->stacklow &&
+     memuse(p, p->sz, va) > p->rlim[RLIMIT_MEM].cur)
+    return -1;
+  if((pte = walkpgdir(p->pgdir, (char*)va, 0)) != 0 && *pte != 0)
+    return -1;
+  if((mem = pagealloc(p->pgdir, 1)) == 0)
+    return -1;
+  if(mappages(p->pgdir, (char*)va, PGSIZE, V2P(mem), PTE_W|PTE_U) < 0){
+    kfree(mem);
+    vmcount(p->pgdir, VM_PGFREE);
+    return -1;
+  }
+  memacct(p->pgdir, 1, 0);
+  if(va < p->stacklow)
+    p->stacklow = va;
+  return 0;
+}
+
+// Fill in any stack pages in [va, va+n) that stackfault() would,
+// so that the kernel can use them without faulting.
+void
+stackfill(struct proc *p, uint va, uint n)
+{
+  uint a;
+
+  for(a = PGROUNDDOWN(va); a < va + n; a += PGSIZE)
+    stackfault(p, a);
+}
+
+// Count a memory event of type ev (a VM_ number) on pgdir for this
+// CPU, and for the process running on it if pgdir is its page table,
+// as memacct() does.  So wait() freeing a child's memory, or fork()
+// filling one, is not booked to the parent.
+void
+vmcount(pde_t *pgdir, int ev)
+{
+  struct cpu *c;
+
+  pushcli();
+  c = mycpu();
+  c->vmev[ev]++;
+  if(c->proc && c->proc->pgdir == pgdir)
+    c->proc->vmev[ev]++;
+  popcli();
+}
+
+// Count the resident user pages of pgdir into *rss and its page
+// table pages, the directory included, into *ptpages.
+void
+vmusage(pde_t *pgdir, uint *rss, uint *ptpages)
+{
+  pte_t *pte;
+  uint a;
+
+  *rss = 0;
+  *ptpages = 1;
+  for(a = 0; a < VDSO_SHARED; a += PGSIZE){
+    if((pte = walkpgdir(pgdir, (char*)a, 0)) == 0){
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+      continue;
+    }
+    if(PTX(a) == 0)
+      (*ptpages)++;
+    if(*pte & PTE_P)
+      (*rss)++;
+  }
+}
+
 //PAGEBREAK!
 // Map user virtual address to kernel address.
 char*
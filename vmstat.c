@@ -0,0 +1,60 @@
+// Memory event counts: page faults, pages and page table pages
+// allocated and freed, swapping and TLB flushes, for the whole
+// system or for one process.  The first line is the totals so far;
+// each later one is what happened over the last interval.
+//
+//   vmstat [-p pid] [-d seconds] [-n count]
+
+#include "types.h"
+#include "user.h"
+#include "vmstat.h"
+
+static void
+display(struct vmstat *v0, struct vmstat *v1)
+{
+  int ev;
+
+  for(ev = 0; ev < NVMSTAT; ev++)
+    printf(1, "%d%s", v1->ev[ev] - v0->ev[ev], ev < NVMSTAT-1 ? "\t" : "\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct vmstat v0, v1;
+  int pid, delay, count, i;
+
+  pid = 0;
+  delay = 1;
+  count = 1;
+  for(i = 1; i + 1 < argc; i += 2){
+    if(strcmp(argv[i], "-p") == 0)
+      pid = atoi(argv[i+1]);
+    else if(strcmp(argv[i], "-d") == 0)
+      delay = atoi(argv[i+1]);
+    else if(strcmp(argv[i], "-n") == 0)
+      count = atoi(argv[i+1]);
+    else
+      break;
+  }
+  if(i != argc || pid < 0 || delay <= 0 || count <= 0){
+    printf(2, "usage: vmstat [-p pid] [-d seconds] [-n count]\n");
+    exit();
+  }
+
+  memset(&v0, 0, sizeof(v0));
+  if(getvmstat(pid, &v1) < 0){
+    printf(2, "vmstat: no process %d\n", pid);
+    exit();
+  }
+  printf(1, "flt\tmajflt\tpgalloc\tpgfree\tptalloc\tptfree\tswapin\tswapout\ttlbflush\n");
+  display(&v0, &v1);
+  while(--count > 0){
+    v0 = v1;
+    sleep(delay * TPS);
+    if(getvmstat(pid, &v1) < 0)
+      break;
+    display(&v0, &v1);
+  }
+  exit();
+}
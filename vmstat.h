@@ -0,0 +1,18 @@
+// Memory event counters kept by vmcount() (see vm.c), for the
+// whole system and for each process.
+// Visible to both user and kernel space.
+
+#define VM_FAULT     0   // page faults resolved, not bad accesses
+#define VM_MAJFAULT  1   // of those, ones that read the page from disk
+#define VM_PGALLOC   2   // user pages allocated
+#define VM_PGFREE    3   // user pages freed
+#define VM_PTALLOC   4   // page table pages allocated
+#define VM_PTFREE    5   // page table pages freed
+#define VM_SWAPIN    6   // pages read back from swap
+#define VM_SWAPOUT   7   // pages written out to swap
+#define VM_TLBFLUSH  8   // %cr3 reloads by switchuvm()
+#define NVMSTAT      9
+
+struct vmstat {
+  uint ev[NVMSTAT];      // counts, indexed by VM_ number
+};